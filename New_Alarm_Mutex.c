@@ -1,602 +1,3153 @@
-/*
-* Niruyan Rakulan 214343438
-* New_Alarm_mutex.c
-* This is an enhancement to the alarm_thread.c program, which
-* created an "alarm thread" for each alarm command. This new
-* version uses multiple alarm threads, which reads the next suitable
-* entry in a list. The main thread places new requests onto the
-* list, in order of messagetype. The list is protected by a mutex.
-* The Threads are able to concurrently deal with alarms
-*
-*/
-#include <pthread.h>
-#include <time.h>
-#include "errors.h"
-#include <regex.h>
-#include <limits.h>
-
-/*
-* The "alarm" structure contains the time_t (time since the
-* Epoch, in seconds) for each alarm, so that they can be
-* sorted in each thread. Storing the requested number of seconds would not be
-* enough, since the "alarm thread" cannot tell how long it has
-* been on the list. seconds variable will provide thread with how long it should
-*wait
-*/
-typedef struct alarm_tag {
-	struct alarm_tag    *link;
-	int                 seconds;
-	time_t              time;   /* seconds from EPOCH */
-	int                 message_type;
-	long                 status;
-	char                message[128];
-} alarm_t;
-
-pthread_mutex_t alarm_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t alarm_cond = PTHREAD_COND_INITIALIZER;
-alarm_t *alarm_list = NULL;
-time_t current_alarm = 0;
-unsigned int terminated_message_type = 0;
-
-typedef struct alarm_thread_tag {
-	struct alarm_thread_tag *link;
-	pthread_t thread_id;
-	int message_type;
-} alarm_thread_t;
-
-/*
- * Insert alram entry in global alarm_list by MessageType.
- */
-void alarm_insert(alarm_t *alarm)
-{
-	int status;
-	alarm_t **last, *next;
-	/*
-	 *Call for mutex so the conditon variable in thread to synched with this function
-	 */
-	status = pthread_mutex_lock (&alarm_mutex);
-	if (status != 0)
-	err_abort (status, "Lock mutex");
-	/*
-	 *Place alarm in list by message type
-	 */
-	last = &alarm_list;
-	next = *last;
-	while(next != NULL){
-		if(next->message_type >= alarm->message_type){
-			alarm->link = next;
-			*last = alarm;
-			break;
-		}
-		last = &next->link;
-		next = next->link;
-	}
-	/* If we reached the end of the list, insert the new alarm
-	* there. ("next" is NULL, and "last" points to the link
-	* field of the last item, or to the list header.)
-	*/
-	if(next == NULL){
-		*last = alarm;
-		alarm->link = NULL;
-	}
-
-#ifdef DEBUG
-	printf("[list: ");
-	for(next = alarm_list; next != NULL; next = next->link)
-	printf("%d(%d)[\"%s\"] ", next->time,
-	next->time/* = time (NULL)*/, next->message);
-	printf("]\n");
-#endif
-
-	 status = pthread_mutex_unlock (&alarm_mutex);
-	 if (status != 0)
-	 err_abort (status, "Unlock mutex");
-	 /*
- 	 *Wake all alarm threads if it is not busy; that is if
- 	 *the thread has no alarm assigned to it, or it has a alarm, but
- 	 *has not gone off yet. It is done after mutex is unlocked
- 	 */
-	status = pthread_cond_broadcast(&alarm_cond);
-	if(status != 0)
-	err_abort(status, "Broadcast cond");
-
-}
-
-/*
- *Removes alarm from the global alarm_list after being assigned to a thread.
- */
-void alarm_remover(alarm_t *alarm){
-	alarm_t *temp_alarm,*temp_alarm_past;
-	int status;
-	temp_alarm_past=NULL;
-	/*
-	 *Lock mutex so the threads are synched
-	 */
-	status = pthread_mutex_lock (&alarm_mutex);
-	if (status != 0)
-	err_abort (status, "Lock mutex");
-	for(temp_alarm = alarm_list; temp_alarm!= NULL; temp_alarm_past=temp_alarm, temp_alarm = (temp_alarm->link)){
-		if(temp_alarm==alarm){
-			if(temp_alarm_past==NULL){
-				alarm_list=temp_alarm->link;
-			}
-			else{
-				temp_alarm_past->link=temp_alarm->link;
-			}
-			temp_alarm->link=NULL;
-
-		}
-	}
-#ifdef DEBUG
-	printf("[list: ");
-	for(temp_alarm = alarm_list; temp_alarm != NULL; temp_alarm = temp_alarm->link)
-	printf("%d(%d)[\"%s\"] ", temp_alarm->time,
-	temp_alarm->time/* = time (NULL)*/, temp_alarm->message);
-	printf("]\n");
-#endif
-
-status = pthread_mutex_unlock (&alarm_mutex);
-if (status != 0)
-err_abort (status, "Unlock mutex");
-
-}
-/*
-This function is reponsible for cleaning up thread after termination
-*/
-void thread_terminate_cleanup(void *list){
-	alarm_t **last, *next, *temp;
-	int status;
-	/*
-	 *Free alarms from the thread's sublist
-	*/
-		last = (alarm_t **)(&list);
-		next = *last;
-		while(next != NULL){
-			temp=next->link;
-			free(next);
-			next=temp;
-		}
-
-	#ifdef DEBUG
-	printf("[list: ");
-	temp_alarm=(alarm_t*)list;
-	for(; temp_alarm != NULL; temp_alarm = temp_alarm->link)
-	printf("%d(%d)[\"%s\"] ", temp_alarm->time,
-	temp_alarm->time/* = time (NULL)*/, temp_alarm->message);
-	printf("]\n");
-	#endif
-	/*
-	 *Release thread mutex before termination
-	*/
-	status = pthread_mutex_unlock (&alarm_mutex);
-	if (status != 0)
-	err_abort (status, "Unlock mutex");
-}
-
-/*
- * The alarm thread's start routine.
- */
-void *alarm_thread (void *arg)
-{
-	alarm_t *alarm,*current_alarm,*thread_alarm_list;
-	int sleep_time;
-	time_t now;
-	int status;
-	/*
-	 *GEt messagetype variable from main
-	 */
-	int type_of_thread = *((int *) arg);
-	free(arg);
-	current_alarm=NULL;
-	thread_alarm_list=NULL;
-	//printf("%ld %d\n",pthread_self(),type_of_thread);
-  /*
-	 *Push the function pthread_mutex_lock to cleanup thread after termination
-	 */
-	pthread_cleanup_push(thread_terminate_cleanup, (void*)thread_alarm_list);
-	/*
-	 * Loop forever, processing commands. The alarm thread will
-	 * be disintegrated when the process exits.
-	 */
-	while (1) {
-		/*
-     *Get Mutex lock
-     */
-		status=pthread_yield();
-		if (status != 0)
-		err_abort (status, "Thread Yield");
-		status = pthread_mutex_lock (&alarm_mutex);
-		if (status != 0)
-		err_abort (status, "Lock mutex");
-		/*
-     *Assign thread local variable alarm to the start of the global
-		 *variable alarm_list
-     */
-		alarm = alarm_list;
-		/*
-     *Thread checks to see if alarm in list with same MessageType and not already assigned is available
-     */
-		if(alarm!=NULL){
-			while(alarm->message_type!=type_of_thread || alarm->status!=0){
-				if(alarm->link != NULL)
-				alarm=alarm->link;
-				else{
-					alarm=NULL;
-					break;
-				}
-
-			}
-		}
-
-		/*
-     *If thread does not have an alarm after checking the list, it waits until
-		 *a new alarm is put into the list through the condition variable,
-		 *and looks at list again
-     */
-		if (alarm == NULL &&  thread_alarm_list==NULL){
-			status = pthread_cond_wait(&alarm_cond, &alarm_mutex);
-			if(status != 0)
-			err_abort(status, "Wait on cond");
-			sleep(0);
-			status = pthread_mutex_unlock (&alarm_mutex);
-			if (status != 0)
-			err_abort (status, "Unlock mutex");
-			continue;
-		}
-		/*
-     *Proceed only if thread found a new alarm in the list, or already has an alarm
-     */
-		else{
-			/*
-			 *Serves as cancellation point
-			 */
-			sleep(0);
-			status = pthread_mutex_unlock (&alarm_mutex);
-			if (status != 0)
-			err_abort (status, "Unlock mutex");
-			/*
-       *If thread found new alarm, assign it, and put it in the thread's sub list
-       */
-			if(alarm!=NULL){
-      /*
-       *Assign alarm to thread
-       */
-				alarm->status=pthread_self();
-				/*
-         *Remove the thread from the global alarm_list
-         */
-				alarm_remover(alarm);
-				status = pthread_mutex_lock (&print_mutex);
-				if (status != 0)
-				err_abort (status, "Lock print mutex");
-				printf("Alarm Request With Message Type (%d) Assigned to Alarm Thread %ld at %d: Type %c\n",alarm->message_type,(long)pthread_self(),time (NULL),'A');
-				status = pthread_mutex_unlock (&print_mutex);
-				if (status != 0)
-				err_abort (status, "Unlock print mutex");
-				alarm->time=time (NULL)+alarm->seconds;
-				alarm_t **last, *next;
-				/*
-	       *Place alarm in local thread list by time
-	       */
-				last = &thread_alarm_list;
-				next = *last;
-				while(next != NULL){
-					if(next->time >= alarm->time){
-						alarm->link = next;
-						*last = alarm;
-						break;
-					}
-					last = &next->link;
-					next = next->link;
-				}
-	/* If we reached the end of the list, insert the new alarm
-	* there. ("next" is NULL, and "last" points to the link
-	* field of the last item, or to the list header.)
-	*/
-				if(next == NULL){
-					*last = alarm;
-					alarm->link = NULL;
-				}
-				/*
-         *Assign the current_alarm with the alarm with the shortest time
-         */
-				current_alarm=thread_alarm_list;
-				alarm=NULL;
-			}
-/*
-*If the current_alarm is ready to go, print the message. and remove it from the thread sublist
-*/
-			now=time(NULL);
-			if (current_alarm->time <= now){
-				status = pthread_mutex_lock (&print_mutex);
-				if (status != 0)
-				err_abort (status, "Lock print mutex");
-
-				printf ("(%d) %s\n", current_alarm->seconds, current_alarm->message);
-				printf("Alarm With Message Type (%d) Printed by Alarm Thread %ld at %d: Type %c \n",current_alarm->message_type,(long)pthread_self(),time (NULL),'A');
-
-				status = pthread_mutex_unlock (&print_mutex);
-				if (status != 0)
-				err_abort (status, "Unlock print mutex");
-
-				if(current_alarm->link==NULL)
-				thread_alarm_list=NULL;
-				else
-				thread_alarm_list=current_alarm->link;
-				free(current_alarm);
-				current_alarm=thread_alarm_list;
-
-			}
-			/*
-       *If the current_alarm is not ready to go, go back to the list, and check if new alarm with same message type is available
-       */
-			 else
-			 continue;
-
-		}
-
-	}
-	/*
-	 *Pop the cleanup function after thread termination
-	 */
-	pthread_cleanup_pop(1);
-}
-
-/**
-Get command type.
-\param line information that user input.
-\param msg_type Output message type.
-\param alarm_second If the command is message command, after the alarm_second,
-					message will be displayed.
-\param message If the command is message command. message contains the message to be
-				displayed.
-\return 1 means create thread command, 2 means terminate command, 3 means message command,
-		-1 means bad command.
-*/
-int get_cmd_type(char* line, unsigned int* msg_type, unsigned int* alarm_second, char* message)
-{
-	char cmd[20];
-	char str_msg_type[20];
-	int ret_value;
-
-	/*
-* Parse input line into seconds (%d) and a message
-* (%128[^\n]), consisting of up to 128 characters
-* separated from the seconds by whitespace.
-*/
-
-	if(sscanf(line, "%d %s %128[^\n]", alarm_second, str_msg_type, message) == 3)
-	{
-		ret_value = 3;
-		sscanf(str_msg_type,"%*[^0123456789]%d",msg_type);
-
-	}else if(sscanf(line, "%s %s[^\n]",cmd, str_msg_type) == 2)
-	{
-		if(sscanf(str_msg_type, "%*[^0123456789]%d", msg_type) == 1 &&
-				strncmp(str_msg_type,"MessageType(",strlen("MessageType(") - 1 ) == 0){
-			if(*msg_type < 1){
-				fprintf (stderr, "Message type must be the positive integer.\n");
-				ret_value = -1;
-			}else if(strcmp(cmd,"Create_Thread:")==0){
-				ret_value = 1;
-			}else if(strcmp(cmd,"Terminate_Thread:") == 0){
-				ret_value = 2;
-			}else
-			{
-				ret_value = -1;
-			}
-		}else
-		{
-			ret_value = -1;
-		}
-	}else
-	{
-		fprintf (stderr, "The number of parameters is not correct.\n");
-		ret_value = -1;
-	}
-
-	return ret_value;
-}
-
-
-//Main Function, or Main thread
-int main (int argc, char *argv[])
-{
-	int status;
-	char line[256];
-	char message[128];
-	unsigned int alarm_second;
-	alarm_t *alarm, **last, *next;
-	int message_type_len;
-	unsigned int message_type;
-	int cmd_type;
-	alarm_thread_t *head_thread, *last_thread, *thread_node;
-	head_thread = last_thread = thread_node = NULL;
-	pthread_t thread;
-	
-	//Loop runs until terminated
-	while (1) {
-		printf ("Alarm> ");
-		if (fgets (line, sizeof (line), stdin) == NULL) exit (0);
-		if (strlen (line) <= 1) continue;
-
-
-		//Get Command Type
-		cmd_type = get_cmd_type(line, &message_type, &alarm_second, message);
-		switch(cmd_type){
-			//If Type B
-		case 1:{
-			status = pthread_mutex_lock (&print_mutex);
-	if (status != 0)
-	err_abort (status, "Lock print mutex");
-
-			/*
-			 *Put messagetype variable in thread
-			 */
-				int *i = malloc(sizeof(*i));
-				*i=message_type;
-				status = pthread_create (&thread, NULL, alarm_thread, (void *) i);
-				if (status != 0)
-				err_abort (status, "Create alarm thread");
-				/*
-		     *Insert thread to thread list
-		     */
-				thread_node = (alarm_thread_t*)calloc(1,sizeof (alarm_thread_t));
-				thread_node->thread_id = thread;
-				thread_node->message_type = message_type;
-
-				if(head_thread == NULL){
-					head_thread = last_thread = thread_node;
-
-				}else
-				{
-					last_thread->link = thread_node;
-					last_thread = thread_node;
-				}
-
-
-				printf("New Alarm Thread %ld For Message Type (%d) Created at %d: Type B\n", (long)thread, message_type, time(NULL));
-				status = pthread_mutex_unlock (&print_mutex);
-	if (status != 0)
-	err_abort (status, "Unlock print mutex");
-
-				break;
-
-				// Type C
-			}case 2:{
-				status = pthread_mutex_lock (&print_mutex);
-	if (status != 0)
-	err_abort (status, "Lock print mutex");
-				terminated_message_type = message_type;
-				int contains=0;
-				alarm_thread_t *temp_thread,*temp_thread_past;
-				/*
-				 *Remove thread of MessageType(x) from list, and cancel thread
-         */
-				temp_thread_past=NULL;
-				for(temp_thread= head_thread; temp_thread!=NULL;){
-					if((temp_thread->message_type)==terminated_message_type){
-						contains=1;
-						/*
-     				 *Terminate thread and remove from linked list
-     				 */
-						pthread_cancel(temp_thread->thread_id);
-						if(head_thread==temp_thread)
-						head_thread=temp_thread->link;
-						else
-						temp_thread_past->link=temp_thread->link;
-						free(temp_thread);
-						if(temp_thread_past==NULL){
-							temp_thread=head_thread;
-
-						}
-						else{
-							temp_thread=temp_thread_past->link;
-						}
-
-
-					}
-					else{
-						temp_thread_past=temp_thread;
-						temp_thread = (temp_thread->link);
-
-					}
-				}
-
-
-				/*
-				 *remove the alarms with specified MessageType
-				 */
-
-				alarm_t *temp_alarm,*temp_alarm_past;
-				status = pthread_mutex_lock (&alarm_mutex);
-				if (status != 0)
-				err_abort (status, "Lock mutex");
-				for(temp_alarm= alarm_list; temp_alarm!=NULL;){
-					if((temp_alarm->message_type)==terminated_message_type){
-						contains=1;
-						if(alarm_list==temp_alarm)
-						alarm_list=temp_alarm->link;
-						else
-						temp_alarm_past->link=temp_alarm->link;
-						free(temp_alarm);
-						if(temp_alarm_past==NULL){
-							temp_alarm=alarm_list;
-						}
-						else{
-							temp_alarm=temp_alarm_past->link;
-						}
-
-					}
-					else{
-						temp_alarm_past=temp_alarm;
-						temp_alarm = (temp_alarm->link);
-					}
-				}
-
-				status = pthread_mutex_unlock (&alarm_mutex);
-				if (status != 0)
-				err_abort (status, "Unlock mutex");
-
-				if (contains){
-					printf("All Alarm Threads For Message Type (%d) Terminated And All Messages of Message Type Removed at %d: Type C\n",terminated_message_type,time(NULL) );
-				}
-
-				#ifdef DEBUG
-				alarm_thread_t *temp;
-				for(temp= head_thread; temp!=NULL && head_thread != NULL; temp= (temp ->link))
-				printf("Thread: %ld %d\n", temp->thread_id,temp->message_type);
-				printf("[list: ");
-				for(next = alarm_list; next != NULL; next = next->link)
-				printf("%d(%d)[\"%s\"] ", next->time,
-				next->time, next->message
-				printf("]\n");
-				#endif
-                status = pthread_mutex_unlock (&print_mutex);
-	if (status != 0)
-	err_abort (status, "Unlock print mutex");
-
-
-				break;
-
-
-				//Type A
-			}case 3:{
-					status = pthread_mutex_lock (&print_mutex);
-	if (status != 0)
-	err_abort (status, "Lock print mutex");
-
-				alarm = (alarm_t*)malloc (sizeof (alarm_t));
-				if (alarm == NULL)
-				errno_abort ("Allocate alarm");
-				alarm->seconds = alarm_second;
-				alarm->time = time (NULL) + alarm->seconds;
-				alarm->message_type = message_type;
-				alarm->status = 0;
-				alarm->link = NULL;
-				strcpy(alarm->message, message);
-
-				/*
-				* Insert the new alarm into the list of alarms,
-				* sorted by Message Type
-				*/
-				alarm_insert(alarm);
-				printf("Alarm Request With Message Type (%d) Inserted by Main Thread %ld Into Alarm List at %d: Type A\n", alarm->message_type, (long)pthread_self(), time (NULL));
-			status = pthread_mutex_unlock (&print_mutex);
-	        if (status != 0)
-	        err_abort (status, "Unlock print mutex");
-				break;
-
-			}case -1:{
-				fprintf (stderr, "Bad command\n");
-				break;
-			}
-		}
-	}
-	
-
-	status=pthread_yield();
-	if (status != 0)
-	err_abort (status, "Thread Yield");
-}
+/*
+* Niruyan Rakulan 214343438
+* New_Alarm_mutex.c
+* This is an enhancement to the alarm_thread.c program, which
+* created an "alarm thread" for each alarm command. This new
+* version uses multiple alarm threads, which reads the next suitable
+* entry in a list. The main thread places new requests onto the
+* list, in order of messagetype. The list is protected by a mutex.
+* The Threads are able to concurrently deal with alarms
+*
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include "errors.h"
+#include "alarm_clock.h"
+#include "alloc_check.h"
+#include "cmd_scan.h"
+#include "command.h"
+#include "dedup.h"
+#include "line_ring.h"
+#include "out_ring.h"
+#include "pool.h"
+#include "reorder.h"
+#include "sched_lock.h"
+#include "shm_stats.h"
+#include "stats.h"
+#include "summary.h"
+#include "tally.h"
+#include "throttle.h"
+#include "timer_queue.h"
+#include "trace.h"
+#include "type_set.h"
+#include <regex.h>
+#include <limits.h>
+
+/*
+* The "alarm" structure contains the time_t (time since the
+* Epoch, in seconds) for each alarm, so that they can be
+* sorted in each thread. Storing the requested number of seconds would not be
+* enough, since the "alarm thread" cannot tell how long it has
+* been on the list. seconds variable will provide thread with how long it should
+*wait. Once a thread takes the alarm, node places it in the thread's
+* timer queue; node must stay the first member so a queue entry can be
+* cast back to its alarm. Alarms are numbered from 1 in the order main
+* accepts them; id is what Reschedule_Alarm refers to. In dispatch mode
+* worker is the thread that will print the alarm. throttled is set once
+* a -t rate limit has delayed the alarm to a second it holds a token for.
+*/
+typedef struct alarm_tag {
+	timerq_node_t       node;
+	struct alarm_tag    *link;
+	struct alarm_tag    *id_link;   /* next alarm in the same index bucket */
+	timerq_t            *queue;     /* owning thread's queue, NULL while in alarm_list */
+	struct worker_tag   *worker;    /* dispatch mode: bound worker */
+	unsigned long       id;
+	int                 seconds;
+	time_t              time;   /* seconds from EPOCH */
+	int                 message_type;
+	long                 status;
+	int                 throttled;
+	char                message[CMD_MESSAGE_MAX + 1];
+} alarm_t;
+
+sched_lock_t alarm_mutex = SCHED_LOCK_INITIALIZER;
+pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t alarm_cond = PTHREAD_COND_INITIALIZER;
+alarm_t *alarm_list = NULL;
+time_t current_alarm = 0;
+unsigned int terminated_message_type = 0;
+timerq_kind_t timer_queue_kind = TIMERQ_LIST;
+long timer_queue_reserve = 0;
+/*
+ * Alarms are taken from and returned to this pool instead of malloc
+ * and free, so scheduling and firing do not touch the heap once the
+ * pool covers the alarms in flight (a2 -p sizes it up front).
+ */
+pool_t alarm_pool = POOL_INITIALIZER (alarm_t, 64);
+#define ALARM_INDEX_BUCKETS 4096
+alarm_t *alarm_index[ALARM_INDEX_BUCKETS];
+unsigned long next_alarm_id = 1;
+/*
+ * Alarm requests identical to one accepted within the last -d seconds
+ * are dropped by main before they reach alarm_list.
+ */
+#define ALARM_DEDUP_CAPACITY 4096
+dedup_t alarm_dedup;
+/*
+ * Per-type fire rate limits (a2 -t); set up before any thread starts
+ * and guarded by alarm_mutex after that.
+ */
+throttle_t fire_throttle;
+/*
+ * With a2 -o, stdout writes into this ring and its writer thread does
+ * the real writes (see out_ring.h).
+ */
+out_ring_t output_ring;
+int output_ringed = 0;
+/*
+ * With a2 -O, fired alarms are written in (deadline, id) order by the
+ * order thread rather than as each thread fires them (see reorder.h).
+ */
+reorder_t fire_order;
+pthread_t order_thread_id;
+/*
+ * With a2 -S, a type firing faster than the given rate is reported in
+ * one summary line a second by the summary thread (see summary.h).
+ */
+summary_t fire_summary;
+pthread_t summary_thread_id;
+/*
+ * With a2 -T, main records every command it takes in this trace, for
+ * a2replay (see trace.h), and the trace thread writes it out. Both
+ * hold trace_mutex to use it; trace_stopped is set once it is closed
+ * or cannot be written. input_traced is only set before threads start.
+ */
+trace_t input_trace;
+int input_traced = 0;
+pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+int trace_stopped = 0;
+pthread_t trace_thread_id;
+
+/*
+ * What an alarm thread has done, for "Stats: Threads": alarms printed,
+ * returns from waiting on a condition variable and trips round its
+ * loop. Only the owning thread updates them; the report reads them
+ * with the thread's CPU clock, so wasted passes show up as CPU spent
+ * per alarm fired.
+ */
+typedef struct thread_usage_tag {
+	unsigned long       fired;
+	unsigned long       wakeups;
+	unsigned long       passes;
+} thread_usage_t;
+
+#define USAGE_ADD(usage, field) \
+	__atomic_fetch_add (&(usage).field, 1, __ATOMIC_RELAXED)
+#define USAGE_READ(usage, field) \
+	__atomic_load_n (&(usage).field, __ATOMIC_RELAXED)
+
+/*
+ * CPU used by threads that have since been terminated, so the report
+ * still accounts for it.
+ */
+unsigned long long retired_cpu_ns = 0;
+unsigned long retired_threads = 0;
+
+/*
+ * In dispatch mode (a2 -m dispatch) the alarm threads do not poll
+ * alarm_list. A single dispatch thread takes every alarm off the list,
+ * binds it to the least loaded worker of its type and keeps it in one
+ * timer queue; when the alarm is due it is posted to that worker's
+ * mailbox, and the worker only prints it. Workers are found by type
+ * through worker_index, which like the dispatch queue is guarded by
+ * alarm_mutex; each mailbox has its own mutex.
+ */
+typedef struct worker_tag {
+	struct worker_tag   *link;      /* next worker in the same index bucket */
+	pthread_t           thread_id;
+	int                 message_type;   /* the lowest type it serves */
+	type_set_t          *types;     /* NULL when it serves message_type alone */
+	long                pending;    /* bound alarms still in the dispatch queue */
+	pthread_mutex_t     mutex;
+	pthread_cond_t      cond;
+	alarm_t             *mailbox;   /* due alarms, oldest first */
+	alarm_t             **mailbox_tail;
+	long                mailbox_count;
+	time_t              progress;   /* when the worker last printed an alarm */
+	int                 overdue;    /* reported by the watchdog, not yet recovered */
+	int                 listed;     /* in worker_index */
+	int                 busy;       /* EDF: holding or printing an alarm */
+	thread_usage_t      usage;
+} worker_t;
+
+int dispatch_mode = 0;
+
+/*
+ * a2 -m edf is dispatch mode with late binding. Alarms wait in the
+ * dispatch queue unbound, and as they come due they move to edf_ready,
+ * which is kept in deadline order. Each pass hands the earliest ready
+ * alarm that some free worker may serve to that worker, one alarm at
+ * a time. Lateness is then shared across all the types a worker serves
+ * rather than piling up behind whichever worker an alarm was bound to
+ * on arrival. busy, listed, edf_ready and edf_free are guarded by
+ * alarm_mutex.
+ */
+int edf_mode = 0;
+alarm_t *edf_ready = NULL, *edf_ready_last = NULL;
+long edf_free = 0;      /* listed workers that are not busy */
+timerq_t dispatch_queue;
+#define WORKER_INDEX_BUCKETS 1024
+#define DISPATCH_BATCH 64
+/*
+ * Workers serving a set of types are not hashed; they all share the
+ * extra bucket WORKER_MULTI, which worker_find looks at for every type.
+ */
+#define WORKER_MULTI WORKER_INDEX_BUCKETS
+worker_t *worker_index[WORKER_INDEX_BUCKETS + 1];
+/*
+ * Parked workers (a2 -k) are out of worker_index while they wait to be
+ * rebound; "Stats: Memory" counts them from here. Guarded by
+ * alarm_mutex.
+ */
+long parked_workers = 0;
+
+/*
+ * Each polling alarm thread keeps its timer queue here and publishes
+ * it on watch_list along with the time of its last pass, so the
+ * watchdog (a2 -w) can find threads whose due alarms are not being
+ * printed. Main allocates the record and puts it on the list; the
+ * thread frees it when it is cancelled. Both the list and the records
+ * are guarded by alarm_mutex.
+ */
+typedef struct thread_watch_tag {
+	struct thread_watch_tag *link;
+	pthread_t           thread_id;
+	int                 message_type;   /* the lowest type it serves */
+	type_set_t          *types;     /* NULL when it serves message_type alone */
+	timerq_t            queue;
+	time_t              progress;   /* when the thread last looked at its queue */
+	int                 overdue;    /* reported by the watchdog, not yet recovered */
+	int                 parked;     /* serving no type; waits on wake */
+	pthread_cond_t      wake;
+	thread_usage_t      usage;
+} thread_watch_t;
+
+thread_watch_t *watch_list = NULL;
+pthread_t main_thread, dispatch_thread_id, watchdog_thread_id;
+time_t watchdog_threshold = 0;
+int watchdog_redistribute = 0;
+#define WATCHDOG_REPORTS 16
+
+#define TYPE_LABEL_SIZE 24
+
+typedef struct watch_report_tag {
+	long                thread;
+	char                type[TYPE_LABEL_SIZE];
+	long                late;
+	long                waiting;
+	time_t              progress;
+	long                moved;
+	long                sibling;
+} watch_report_t;
+
+typedef struct alarm_thread_tag {
+	struct alarm_thread_tag *link;
+	pthread_t thread_id;
+	int message_type;   /* the lowest type it serves */
+	thread_watch_t *watch;  /* poll mode only */
+	worker_t *worker;   /* dispatch mode only */
+} alarm_thread_t;
+
+/*
+ * With a2 -k, up to idle_max threads of terminated types are parked
+ * here instead of being cancelled, and the next Create_Thread rebinds
+ * one to its type rather than creating a thread. Only main uses the
+ * list.
+ */
+alarm_thread_t *idle_threads = NULL;
+long idle_count = 0;
+long idle_max = 0;
+
+/*
+ * Whether a thread serving message_type, or the set types when there
+ * is one, takes alarms of the given type.
+ */
+int serves(int message_type, type_set_t *types, int type)
+{
+	return types != NULL ? type_set_has(types, type) : type == message_type;
+}
+
+/*
+ * Whether two threads serve the same types, which makes them siblings.
+ */
+int same_types(int type_a, type_set_t *types_a, int type_b, type_set_t *types_b)
+{
+	if (types_a == NULL || types_b == NULL)
+		return types_a == types_b && type_a == type_b;
+	return type_set_equal(types_a, types_b);
+}
+
+/*
+ * The types a thread serves as the reports show them: "5", or a set
+ * such as "2-3,7".
+ */
+void type_label(int message_type, type_set_t *types, char *buf, size_t size)
+{
+	if (types != NULL)
+		type_set_format(types, buf, size);
+	else
+		snprintf(buf, size, "%d", message_type);
+}
+
+/*
+ * The pending alarms of each type, for the -s publisher (see tally.h).
+ * Guarded by alarm_mutex.
+ */
+tally_t pending_tally;
+
+/*
+ * With -s, the alarm rows of "Stats: Memory" are also kept as running
+ * totals, so the publisher need not walk the alarms to fill them in:
+ * the alarm list and queue rows, counted as alarms enter and leave
+ * them, and the messages those alarms hold. Alarms leave mailboxes
+ * under the worker's mutex alone, so the totals are updated
+ * atomically. memory_running is set before any thread starts.
+ */
+stats_memory_t alarm_memory;
+int memory_running = 0;
+
+/*
+ * Count an alarm into (delta 1) or out of (delta -1) the part of
+ * alarm_memory it is in.
+ */
+void memory_count(int part, alarm_t *alarm, int delta)
+{
+	long bytes = strlen(alarm->message) + 1;
+
+	if (!memory_running)
+		return;
+	__atomic_fetch_add(&alarm_memory.objects[part], delta, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&alarm_memory.bytes[part], (unsigned long)(delta * (long)sizeof (alarm_t)), __ATOMIC_RELAXED);
+	__atomic_fetch_add(&alarm_memory.objects[STATS_MEM_MESSAGES], delta, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&alarm_memory.bytes[STATS_MEM_MESSAGES], (unsigned long)(delta * bytes), __ATOMIC_RELAXED);
+}
+
+/*
+ * Count an alarm into (delta 1) or out of (delta -1) the tallies and
+ * memory totals for where it is: alarm_list while it has no queue, a
+ * timer queue once it has one. Every alarm in the index is counted.
+ * Requires alarm_mutex.
+ */
+void alarm_count(alarm_t *alarm, int delta)
+{
+	if (alarm->queue == NULL) {
+		tally_add(&pending_tally, alarm->message_type, delta, 0);
+		memory_count(STATS_MEM_ALARM_LIST, alarm, delta);
+	} else {
+		tally_add(&pending_tally, alarm->message_type, 0, delta);
+		memory_count(STATS_MEM_QUEUES, alarm, delta);
+	}
+}
+
+/*
+ * Give an alarm taken off alarm_list to queue, moving it from the
+ * waiting to the queued tally. Requires alarm_mutex.
+ */
+void alarm_take(alarm_t *alarm, timerq_t *queue)
+{
+	alarm_count(alarm, -1);
+	alarm->queue = queue;
+	alarm_count(alarm, 1);
+}
+
+/*
+ * Alarms are indexed by ID so Reschedule_Alarm can find one without
+ * walking alarm_list or the threads' queues. IDs are handed out in
+ * sequence, so the low bits spread them evenly over the buckets; each
+ * bucket chains through the alarms themselves and the index never
+ * allocates. Code walking a bucket may unlink an alarm itself, and
+ * then calls alarm_count as these do. All three functions require
+ * alarm_mutex.
+ */
+void alarm_index_add(alarm_t *alarm)
+{
+	alarm_t **bucket = &alarm_index[alarm->id & (ALARM_INDEX_BUCKETS - 1)];
+
+	alarm->id_link = *bucket;
+	*bucket = alarm;
+	alarm_count(alarm, 1);
+}
+
+void alarm_index_remove(alarm_t *alarm)
+{
+	alarm_t **last = &alarm_index[alarm->id & (ALARM_INDEX_BUCKETS - 1)];
+
+	while (*last != NULL && *last != alarm)
+		last = &(*last)->id_link;
+	if (*last != NULL) {
+		*last = alarm->id_link;
+		alarm_count(alarm, -1);
+	}
+	alarm->id_link = NULL;
+}
+
+alarm_t *alarm_index_find(unsigned long id)
+{
+	alarm_t *alarm = alarm_index[id & (ALARM_INDEX_BUCKETS - 1)];
+
+	while (alarm != NULL && alarm->id != id)
+		alarm = alarm->id_link;
+	return alarm;
+}
+
+/*
+ * Apply the -t rate limit for its type to an alarm that has just come
+ * due and been taken out of its queue. A delayed alarm gets its new
+ * time and key, and the caller puts it back in the queue; a dropped one
+ * is the caller's to return to the pool. Requires alarm_mutex.
+ */
+throttle_verdict_t alarm_throttle(alarm_t *alarm, time_t now)
+{
+	throttle_verdict_t verdict;
+	time_t when;
+
+	if (alarm->throttled)
+		return THROTTLE_FIRE;
+	verdict = throttle_check(&fire_throttle, alarm->message_type, now, &when);
+	if (verdict == THROTTLE_DELAY) {
+		alarm->throttled = 1;
+		alarm->time = when;
+		alarm->node.key = when;
+		STATS_ADD(throttled, 1);
+	} else if (verdict == THROTTLE_DROP)
+		STATS_ADD(dropped, 1);
+	return verdict;
+}
+
+/*
+ * Insert alram entry in global alarm_list by MessageType.
+ */
+void alarm_insert(alarm_t *alarm)
+{
+	int status;
+	alarm_t **last, *next;
+	ALLOC_GUARD_ENTER ();
+	/*
+	 *Call for mutex so the conditon variable in thread to synched with this function
+	 */
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	/*
+	 *Place alarm in list by message type
+	 */
+	last = &alarm_list;
+	next = *last;
+	while(next != NULL){
+		if(next->message_type >= alarm->message_type){
+			alarm->link = next;
+			*last = alarm;
+			break;
+		}
+		last = &next->link;
+		next = next->link;
+	}
+	/* If we reached the end of the list, insert the new alarm
+	* there. ("next" is NULL, and "last" points to the link
+	* field of the last item, or to the list header.)
+	*/
+	if(next == NULL){
+		*last = alarm;
+		alarm->link = NULL;
+	}
+	alarm_index_add(alarm);
+
+#ifdef DEBUG
+	printf("[list: ");
+	for(next = alarm_list; next != NULL; next = next->link)
+	printf("%d(%d)[\"%s\"] ", next->time,
+	next->time/* = time (NULL)*/, next->message);
+	printf("]\n");
+#endif
+
+	 status = sched_lock_unlock (&alarm_mutex);
+	 if (status != 0)
+	 err_abort (status, "Unlock mutex");
+	 /*
+ 	 *Wake all alarm threads if it is not busy; that is if
+ 	 *the thread has no alarm assigned to it, or it has a alarm, but
+ 	 *has not gone off yet. It is done after mutex is unlocked
+ 	 */
+	status = sched_lock_broadcast(&alarm_mutex, &alarm_cond);
+	if(status != 0)
+	err_abort(status, "Broadcast cond");
+	ALLOC_GUARD_EXIT ();
+}
+
+/*
+ *Removes alarm from the global alarm_list after being assigned to a thread.
+ *The caller must hold alarm_mutex.
+ */
+void alarm_remover(alarm_t *alarm){
+	alarm_t *temp_alarm,*temp_alarm_past;
+	temp_alarm_past=NULL;
+	for(temp_alarm = alarm_list; temp_alarm!= NULL; temp_alarm_past=temp_alarm, temp_alarm = (temp_alarm->link)){
+		if(temp_alarm==alarm){
+			if(temp_alarm_past==NULL){
+				alarm_list=temp_alarm->link;
+			}
+			else{
+				temp_alarm_past->link=temp_alarm->link;
+			}
+			temp_alarm->link=NULL;
+			break;
+		}
+	}
+#ifdef DEBUG
+	printf("[list: ");
+	for(temp_alarm = alarm_list; temp_alarm != NULL; temp_alarm = temp_alarm->link)
+	printf("%d(%d)[\"%s\"] ", temp_alarm->time,
+	temp_alarm->time/* = time (NULL)*/, temp_alarm->message);
+	printf("]\n");
+#endif
+}
+
+/*
+ * Give an alarm a new delay of seconds, counted from now. An alarm
+ * still waiting in alarm_list keeps its place, which is by type, and
+ * starts counting the new delay when a thread takes it. An alarm
+ * already in a thread's timer queue is moved within that queue. A
+ * -t delay the alarm was given no longer stands: the token it took
+ * goes back, and it is checked against the rate limit again when it
+ * next comes due. The alarm is
+ * neither copied nor reallocated. Returns 0, or -1 if no pending
+ * alarm has that ID.
+ */
+int alarm_reschedule(unsigned long id, int seconds)
+{
+	alarm_t *alarm;
+	int status, found = 0;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	alarm = alarm_index_find(id);
+	if (alarm != NULL) {
+		found = 1;
+		if (alarm->throttled) {
+			throttle_release(&fire_throttle, alarm->message_type, alarm->time);
+			alarm->throttled = 0;
+		}
+		alarm->seconds = seconds;
+		alarm->time = alarm_clock_now () + seconds;
+		if (alarm->queue != NULL) {
+			status = timerq_update(alarm->queue, &alarm->node, alarm->time);
+			if (status != 0)
+			err_abort (status, "Update timer queue");
+		}
+	}
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+	/*
+	 *The dispatch thread sleeps until its earliest deadline, which may
+	 *just have moved
+	 */
+	if (found && dispatch_mode) {
+		status = sched_lock_broadcast(&alarm_mutex, &alarm_cond);
+		if (status != 0)
+		err_abort (status, "Broadcast cond");
+	}
+	return found ? 0 : -1;
+}
+
+/*
+ * Add the calling thread's CPU time to the retired total; called as a
+ * thread is terminated.
+ */
+void usage_retire(void)
+{
+	struct timespec cpu;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) != 0)
+		return;
+	__atomic_fetch_add(&retired_cpu_ns,
+		(unsigned long long)cpu.tv_sec * 1000000000ULL + cpu.tv_nsec, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&retired_threads, 1, __ATOMIC_RELAXED);
+}
+
+/*
+This function is reponsible for cleaning up thread after termination
+*/
+void thread_terminate_cleanup(void *arg){
+	thread_watch_t *watch = (thread_watch_t *)arg;
+	timerq_t *queue = &watch->queue;
+	thread_watch_t **last;
+	alarm_t *next;
+	int status;
+	/*
+	 *Termination is not steady state; the thread may free its queue
+	 */
+	ALLOC_GUARD_CLEAR ();
+	/*
+	 *Return alarms from the thread's timer queue to the pool. The
+	 *thread is only cancelled while it holds alarm_mutex.
+	*/
+		while((next = (alarm_t *)timerq_pop(queue)) != NULL){
+	#ifdef DEBUG
+			printf("[freed: %d[\"%s\"]]\n", next->time, next->message);
+	#endif
+			alarm_index_remove(next);
+			pool_put(&alarm_pool, next);
+		}
+		timerq_destroy(queue);
+		usage_retire();
+		for(last = &watch_list; *last != NULL; last = &(*last)->link){
+			if(*last == watch){
+				*last = watch->link;
+				break;
+			}
+		}
+	/*
+	 *Release thread mutex before termination
+	*/
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+	pthread_cond_destroy(&watch->wake);
+	type_set_free(watch->types);
+	free(watch);
+}
+
+/*
+ * Print the lines for an alarm that has fired, headed by its
+ * assignment when the worker was only chosen now (EDF). With -S they
+ * may be folded into the type's summary, and with -O they go to
+ * fire_order instead, making room first if it is full. Requires
+ * print_mutex.
+ */
+void fire_print(alarm_t *alarm, int assigned)
+{
+	reorder_entry_t *entry;
+	time_t now = alarm_clock_now ();
+	int len = 0;
+
+	if (summary_fold(&fire_summary, alarm->message_type, alarm->message, now - alarm->time, now))
+		return;
+	if (fire_order.window == 0) {
+		if (assigned)
+			printf("Alarm Request With Message Type (%d) Assigned to Alarm Thread %ld at %ld: Type %c\n",alarm->message_type,(long)pthread_self(),(long)alarm_clock_now (),'A');
+		printf ("(%d) %s\n", alarm->seconds, alarm->message);
+		printf("Alarm With Message Type (%d) Printed by Alarm Thread %ld at %ld: Type %c \n",alarm->message_type,(long)pthread_self(),(long)alarm_clock_now (),'A');
+		return;
+	}
+	while ((entry = reorder_slot(&fire_order)) == NULL) {
+		entry = reorder_pop(&fire_order, 0, 1);
+		fputs(entry->text, stdout);
+		reorder_release(&fire_order, entry);
+	}
+	entry->time = alarm->time;
+	entry->seq = alarm->id;
+	if (assigned)
+		len = reorder_append(entry, len, "Alarm Request With Message Type (%d) Assigned to Alarm Thread %ld at %ld: Type %c\n",alarm->message_type,(long)pthread_self(),(long)alarm_clock_now (),'A');
+	len = reorder_append(entry, len, "(%d) %s\n", alarm->seconds, alarm->message);
+	reorder_append(entry, len, "Alarm With Message Type (%d) Printed by Alarm Thread %ld at %ld: Type %c \n",alarm->message_type,(long)pthread_self(),(long)alarm_clock_now (),'A');
+	reorder_push(&fire_order, entry);
+}
+
+/*
+ * The alarm thread's start routine.
+ */
+void *alarm_thread (void *arg)
+{
+	alarm_t *alarm,*current_alarm;
+	/*
+	 *Main has set up the thread's record, timer queue and type
+	 */
+	thread_watch_t *watch = (thread_watch_t *)arg;
+	int type_of_thread, assigned_type;
+	int sleep_time;
+	time_t now;
+	int status;
+	current_alarm=NULL;
+	/*
+	 *The thread can only be cancelled at the two points below where it
+	 *holds alarm_mutex, so the cleanup handler always finds the mutex
+	 *locked and the queue consistent.
+	 */
+	status = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	if (status != 0)
+	err_abort (status, "Disable cancel");
+  /*
+	 *Push the function pthread_mutex_lock to cleanup thread after termination
+	 */
+	pthread_cleanup_push(thread_terminate_cleanup, (void*)watch);
+	/*
+	 * Loop forever, processing commands. The alarm thread will
+	 * be disintegrated when the process exits. Everything from here
+	 * on is steady state and must not allocate.
+	 */
+	ALLOC_GUARD_ENTER ();
+	while (1) {
+		/*
+     *Get Mutex lock
+     */
+		status=sched_yield();
+		if (status != 0)
+		errno_abort ("Thread Yield");
+		status = sched_lock_lock (&alarm_mutex);
+		if (status != 0)
+		err_abort (status, "Lock mutex");
+		USAGE_ADD(watch->usage, passes);
+		/*
+		 *A parked thread waits to be given a type again, or cancelled
+		 */
+		if (watch->parked) {
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			status = sched_lock_wait(&alarm_mutex, &watch->wake);
+			if(status != 0)
+			err_abort(status, "Wait on cond");
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+			status = sched_lock_unlock (&alarm_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock mutex");
+			continue;
+		}
+		type_of_thread = watch->message_type;
+		/*
+     *Assign thread local variable alarm to the start of the global
+		 *variable alarm_list
+     */
+		alarm = alarm_list;
+		/*
+     *Thread checks to see if alarm in list with same MessageType and not already assigned is available
+     */
+		if(alarm!=NULL){
+			while(!serves(type_of_thread, watch->types, alarm->message_type) || alarm->status!=0){
+				if(alarm->link != NULL)
+				alarm=alarm->link;
+				else{
+					alarm=NULL;
+					break;
+				}
+
+			}
+		}
+
+		/*
+     *If thread does not have an alarm after checking the list, it waits until
+		 *a new alarm is put into the list through the condition variable,
+		 *and looks at list again
+     */
+		if (alarm == NULL &&  watch->queue.count==0){
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			status = sched_lock_wait(&alarm_mutex, &alarm_cond);
+			if(status != 0)
+			err_abort(status, "Wait on cond");
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+			USAGE_ADD(watch->usage, wakeups);
+			status = sched_lock_unlock (&alarm_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock mutex");
+			continue;
+		}
+		/*
+     *Proceed only if thread found a new alarm in the list, or already has an alarm
+     */
+		/*
+		 *Serves as cancellation point
+		 */
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		pthread_testcancel();
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		/*
+       *If thread found new alarm, assign it, and move it from the global
+       *alarm_list to the thread's timer queue, ordered by time. The queue
+       *is guarded by alarm_mutex so main can reschedule alarms in it.
+       */
+		if(alarm!=NULL){
+			assigned_type = alarm->message_type;
+			alarm->status=pthread_self();
+			alarm_remover(alarm);
+			alarm->time=alarm_clock_now ()+alarm->seconds;
+			alarm->node.key = alarm->time;
+			alarm_take(alarm, &watch->queue);
+			status = timerq_insert(&watch->queue, &alarm->node);
+			if (status != 0)
+			err_abort (status, "Insert timer queue");
+		}
+		/*
+		 *If the alarm with the shortest time is ready to go, take it out of
+		 *the queue and the index before letting go of the mutex
+		 */
+		current_alarm=(alarm_t *)timerq_peek(&watch->queue);
+		now=alarm_clock_now ();
+		watch->progress = now;
+		if (current_alarm->time <= now){
+			timerq_remove(&watch->queue, &current_alarm->node);
+			switch (alarm_throttle(current_alarm, now)) {
+			case THROTTLE_DELAY:
+				status = timerq_insert(&watch->queue, &current_alarm->node);
+				if (status != 0)
+				err_abort (status, "Insert timer queue");
+				current_alarm=NULL;
+				break;
+			case THROTTLE_DROP:
+				alarm_index_remove(current_alarm);
+				pool_put(&alarm_pool, current_alarm);
+				current_alarm=NULL;
+				break;
+			default:
+				alarm_index_remove(current_alarm);
+			}
+		}
+		else
+			current_alarm=NULL;
+		status = sched_lock_unlock (&alarm_mutex);
+		if (status != 0)
+		err_abort (status, "Unlock mutex");
+
+		/*
+		 *The alarm itself is not touched once alarm_mutex is released:
+		 *main may have parked the thread and returned it to the pool
+		 */
+		if(alarm!=NULL){
+			status = pthread_mutex_lock (&print_mutex);
+			if (status != 0)
+			err_abort (status, "Lock print mutex");
+			printf("Alarm Request With Message Type (%d) Assigned to Alarm Thread %ld at %ld: Type %c\n",assigned_type,(long)pthread_self(),(long)alarm_clock_now (),'A');
+			status = pthread_mutex_unlock (&print_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock print mutex");
+		}
+/*
+*If the current_alarm is ready to go, print the message and return it to the pool.
+*Otherwise go back to the list, and check if new alarm with same message type is available
+*/
+		if (current_alarm != NULL){
+			status = pthread_mutex_lock (&print_mutex);
+			if (status != 0)
+			err_abort (status, "Lock print mutex");
+
+			fire_print(current_alarm, 0);
+
+			status = pthread_mutex_unlock (&print_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock print mutex");
+
+			/*
+			 *Counted before it goes back, so a barrier woken by the
+			 *put sees the fire
+			 */
+			STATS_ADD(fired, 1);
+			USAGE_ADD(watch->usage, fired);
+			pool_put(&alarm_pool, current_alarm);
+		}
+
+	}
+	/*
+	 *Pop the cleanup function after thread termination
+	 */
+	pthread_cleanup_pop(1);
+}
+
+/*
+ * Park a polling thread whose type has been terminated. Its queued
+ * alarms go back to the pool, as they would if it were cancelled, and
+ * it stops looking at alarm_list until thread_unpark gives it a type.
+ */
+void thread_park(thread_watch_t *watch)
+{
+	alarm_t *alarm;
+	int status;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	while ((alarm = (alarm_t *)timerq_pop(&watch->queue)) != NULL) {
+		alarm_index_remove(alarm);
+		pool_put(&alarm_pool, alarm);
+	}
+	watch->parked = 1;
+	watch->message_type = 0;
+	type_set_free(watch->types);
+	watch->types = NULL;
+	watch->overdue = 0;
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+}
+
+/*
+ * Give a parked polling thread a new type or set of types. It may not
+ * have noticed it was parked and still be waiting on alarm_cond, so
+ * that is woken too.
+ */
+void thread_unpark(thread_watch_t *watch, int message_type, type_set_t *types)
+{
+	int status;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	watch->message_type = message_type;
+	watch->types = types;
+	watch->progress = alarm_clock_now ();
+	watch->parked = 0;
+	status = sched_lock_signal(&alarm_mutex, &watch->wake);
+	if (status != 0)
+	err_abort (status, "Signal thread");
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+	status = sched_lock_broadcast(&alarm_mutex, &alarm_cond);
+	if (status != 0)
+	err_abort (status, "Broadcast cond");
+}
+
+/*
+ * Stop a polling thread serving one type of its set. The type leaves
+ * the set and the thread's queued alarms of that type go back to the
+ * pool; the thread goes on serving the rest.
+ */
+void thread_drop_type(thread_watch_t *watch, int message_type)
+{
+	alarm_t **bucket, *alarm;
+	int status, i;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	status = type_set_remove(watch->types, message_type);
+	if (status != 0)
+	err_abort (status, "Remove message type");
+	watch->message_type = watch->types->ranges[0].lo;
+	for (i = 0; i < ALARM_INDEX_BUCKETS; i++) {
+		bucket = &alarm_index[i];
+		while ((alarm = *bucket) != NULL) {
+			if (alarm->queue == &watch->queue && alarm->message_type == message_type) {
+				*bucket = alarm->id_link;
+				alarm_count(alarm, -1);
+				timerq_remove(&watch->queue, &alarm->node);
+				pool_put(&alarm_pool, alarm);
+			} else
+				bucket = &alarm->id_link;
+		}
+	}
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+}
+
+/*
+ * Find the least loaded worker for a message type, or NULL if there is
+ * none: those serving the type alone, then those serving it among a
+ * set. Among equally loaded workers the oldest is chosen. Requires
+ * alarm_mutex.
+ */
+worker_t *worker_find(int message_type)
+{
+	worker_t *worker, *best = NULL;
+	int b;
+
+	for (b = 0; b < 2; b++)
+		for (worker = worker_index[b ? WORKER_MULTI : message_type & (WORKER_INDEX_BUCKETS - 1)];
+				worker != NULL; worker = worker->link)
+			if (serves(worker->message_type, worker->types, message_type)
+					&& (best == NULL || worker->pending < best->pending))
+				best = worker;
+	return best;
+}
+
+/*
+ * EDF: the oldest free worker that may serve a message type, or NULL.
+ * Requires alarm_mutex.
+ */
+worker_t *worker_find_free(int message_type)
+{
+	worker_t *worker;
+	int b;
+
+	for (b = 0; b < 2; b++)
+		for (worker = worker_index[b ? WORKER_MULTI : message_type & (WORKER_INDEX_BUCKETS - 1)];
+				worker != NULL; worker = worker->link)
+			if (!worker->busy && serves(worker->message_type, worker->types, message_type))
+				return worker;
+	return NULL;
+}
+
+/*
+ * The index bucket a worker belongs in.
+ */
+worker_t **worker_bucket(worker_t *worker)
+{
+	if (worker->types != NULL)
+		return &worker_index[WORKER_MULTI];
+	return &worker_index[worker->message_type & (WORKER_INDEX_BUCKETS - 1)];
+}
+
+/*
+ * Register a new worker. Workers are appended so worker_find prefers
+ * the older of two idle ones. Wakes the dispatch thread, which may now
+ * be able to bind alarms waiting in alarm_list.
+ */
+void worker_register(worker_t *worker)
+{
+	worker_t **last = worker_bucket(worker);
+	int status;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	while (*last != NULL)
+		last = &(*last)->link;
+	worker->link = NULL;
+	*last = worker;
+	worker->listed = 1;
+	if (!worker->busy)
+		edf_free++;
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+	status = sched_lock_broadcast(&alarm_mutex, &alarm_cond);
+	if (status != 0)
+	err_abort (status, "Broadcast cond");
+}
+
+/*
+ * Take a worker out of service before it is cancelled: no new alarms
+ * are bound to it, and the alarms already bound to it are dropped from
+ * the dispatch queue, so nothing refers to the worker once it has
+ * freed itself. Alarms already in its mailbox go with the worker.
+ */
+void worker_retire(worker_t *worker)
+{
+	worker_t **last = worker_bucket(worker);
+	alarm_t **bucket, *alarm;
+	int status, i;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	while (*last != NULL && *last != worker)
+		last = &(*last)->link;
+	if (*last != NULL)
+		*last = worker->link;
+	if (worker->listed && !worker->busy)
+		edf_free--;
+	worker->listed = 0;
+	for (i = 0; i < ALARM_INDEX_BUCKETS; i++) {
+		bucket = &alarm_index[i];
+		while ((alarm = *bucket) != NULL) {
+			if (alarm->queue == &dispatch_queue && alarm->worker == worker) {
+				*bucket = alarm->id_link;
+				alarm_count(alarm, -1);
+				timerq_remove(&dispatch_queue, &alarm->node);
+				pool_put(&alarm_pool, alarm);
+			} else
+				bucket = &alarm->id_link;
+		}
+	}
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+}
+
+/*
+ * Hand a due alarm to its worker. Requires alarm_mutex, which keeps
+ * the worker from being retired meanwhile.
+ */
+void worker_post(worker_t *worker, alarm_t *alarm)
+{
+	int status;
+
+	status = pthread_mutex_lock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Lock worker mutex");
+	alarm->link = NULL;
+	*worker->mailbox_tail = alarm;
+	worker->mailbox_tail = &alarm->link;
+	worker->mailbox_count++;
+	memory_count(STATS_MEM_QUEUES, alarm, 1);
+	status = pthread_cond_signal (&worker->cond);
+	if (status != 0)
+	err_abort (status, "Signal worker");
+	status = pthread_mutex_unlock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Unlock worker mutex");
+}
+
+/*
+ * Park a worker whose type has been terminated: retire it and return
+ * the alarms in its mailbox to the pool. The worker itself goes on
+ * waiting on its empty mailbox until worker_unpark registers it again.
+ */
+void worker_park(worker_t *worker)
+{
+	alarm_t *alarm;
+	int status;
+
+	worker_retire(worker);
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	status = pthread_mutex_lock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Lock worker mutex");
+	/*
+	 *Under EDF an alarm dropped from the mailbox will not be printed,
+	 *so nothing else would mark the worker free again
+	 */
+	if (worker->mailbox != NULL)
+		worker->busy = 0;
+	while ((alarm = worker->mailbox) != NULL) {
+		worker->mailbox = alarm->link;
+		memory_count(STATS_MEM_QUEUES, alarm, -1);
+		pool_put(&alarm_pool, alarm);
+	}
+	worker->mailbox_tail = &worker->mailbox;
+	worker->mailbox_count = 0;
+	worker->pending = 0;
+	worker->overdue = 0;
+	type_set_free(worker->types);
+	worker->types = NULL;
+	status = pthread_mutex_unlock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Unlock worker mutex");
+	parked_workers++;
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+}
+
+void worker_unpark(worker_t *worker, int message_type, type_set_t *types)
+{
+	int status;
+
+	status = pthread_mutex_lock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Lock worker mutex");
+	worker->message_type = message_type;
+	worker->types = types;
+	worker->progress = alarm_clock_now ();
+	status = pthread_mutex_unlock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Unlock worker mutex");
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	parked_workers--;
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+	worker_register(worker);
+}
+
+/*
+ * Stop a worker serving one type of its set: the type leaves the set,
+ * and the alarms of that type bound to the worker, whether still in
+ * the dispatch queue or already in its mailbox, go back to the pool.
+ */
+void worker_drop_type(worker_t *worker, int message_type)
+{
+	alarm_t **bucket, **last, *alarm;
+	int status, i;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	status = type_set_remove(worker->types, message_type);
+	if (status != 0)
+	err_abort (status, "Remove message type");
+	for (i = 0; i < ALARM_INDEX_BUCKETS; i++) {
+		bucket = &alarm_index[i];
+		while ((alarm = *bucket) != NULL) {
+			if (alarm->queue == &dispatch_queue && alarm->worker == worker
+					&& alarm->message_type == message_type) {
+				*bucket = alarm->id_link;
+				alarm_count(alarm, -1);
+				timerq_remove(&dispatch_queue, &alarm->node);
+				worker->pending--;
+				pool_put(&alarm_pool, alarm);
+			} else
+				bucket = &alarm->id_link;
+		}
+	}
+	status = pthread_mutex_lock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Lock worker mutex");
+	worker->message_type = worker->types->ranges[0].lo;
+	worker->mailbox_tail = &worker->mailbox;
+	for (last = &worker->mailbox; (alarm = *last) != NULL; ) {
+		if (alarm->message_type == message_type) {
+			*last = alarm->link;
+			worker->mailbox_count--;
+			memory_count(STATS_MEM_QUEUES, alarm, -1);
+			pool_put(&alarm_pool, alarm);
+			if (worker->busy) {
+				worker->busy = 0;
+				edf_free++;
+			}
+		} else {
+			last = &alarm->link;
+			worker->mailbox_tail = last;
+		}
+	}
+	status = pthread_mutex_unlock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Unlock worker mutex");
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+}
+
+/*
+ * A worker is only cancelled while it waits on its mailbox, holding
+ * the mailbox mutex. It has already been retired, so it returns what
+ * is left in the mailbox to the pool and frees itself.
+ */
+void worker_cleanup(void *arg)
+{
+	worker_t *worker = (worker_t *)arg;
+	alarm_t *alarm;
+
+	ALLOC_GUARD_CLEAR ();
+	usage_retire();
+	while ((alarm = worker->mailbox) != NULL) {
+		worker->mailbox = alarm->link;
+		memory_count(STATS_MEM_QUEUES, alarm, -1);
+		pool_put(&alarm_pool, alarm);
+	}
+	pthread_mutex_unlock (&worker->mutex);
+	pthread_mutex_destroy (&worker->mutex);
+	pthread_cond_destroy (&worker->cond);
+	type_set_free(worker->types);
+	free(worker);
+}
+
+/*
+ * The worker's start routine: print the alarms the dispatch thread
+ * posts, in the order they are posted.
+ */
+void *worker_thread(void *arg)
+{
+	worker_t *worker = (worker_t *)arg;
+	alarm_t *alarm;
+	int status;
+
+	status = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	if (status != 0)
+	err_abort (status, "Disable cancel");
+	status = pthread_mutex_lock (&worker->mutex);
+	if (status != 0)
+	err_abort (status, "Lock worker mutex");
+	pthread_cleanup_push(worker_cleanup, worker);
+	ALLOC_GUARD_ENTER ();
+	while (1) {
+		while (worker->mailbox == NULL) {
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+			status = pthread_cond_wait(&worker->cond, &worker->mutex);
+			if (status != 0)
+			err_abort (status, "Wait on worker cond");
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+			USAGE_ADD(worker->usage, wakeups);
+		}
+		USAGE_ADD(worker->usage, passes);
+		alarm = worker->mailbox;
+		worker->mailbox = alarm->link;
+		if (worker->mailbox == NULL)
+			worker->mailbox_tail = &worker->mailbox;
+		worker->mailbox_count--;
+		memory_count(STATS_MEM_QUEUES, alarm, -1);
+		status = pthread_mutex_unlock (&worker->mutex);
+		if (status != 0)
+		err_abort (status, "Unlock worker mutex");
+
+		status = pthread_mutex_lock (&print_mutex);
+		if (status != 0)
+		err_abort (status, "Lock print mutex");
+		/*
+		 *Under EDF the worker is only chosen when the alarm is due
+		 */
+		fire_print(alarm, edf_mode);
+		status = pthread_mutex_unlock (&print_mutex);
+		if (status != 0)
+		err_abort (status, "Unlock print mutex");
+		STATS_ADD(fired, 1);
+		USAGE_ADD(worker->usage, fired);
+		pool_put(&alarm_pool, alarm);
+		if (edf_mode) {
+			status = sched_lock_lock (&alarm_mutex);
+			if (status != 0)
+			err_abort (status, "Lock mutex");
+			if (worker->busy) {
+				worker->busy = 0;
+				if (worker->listed)
+					edf_free++;
+			}
+			status = sched_lock_unlock (&alarm_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock mutex");
+			status = sched_lock_broadcast(&alarm_mutex, &alarm_cond);
+			if (status != 0)
+			err_abort (status, "Broadcast cond");
+		}
+
+		status = pthread_mutex_lock (&worker->mutex);
+		if (status != 0)
+		err_abort (status, "Lock worker mutex");
+		worker->progress = alarm_clock_now ();
+	}
+	pthread_cleanup_pop(1);
+}
+
+/*
+ * The dispatch thread's start routine. It owns every deadline: it
+ * binds alarms from alarm_list in list order, announces the bindings
+ * once it has let go of alarm_mutex, posts alarms to their workers as
+ * they come due and otherwise sleeps until the earliest deadline or
+ * until main changes something.
+ */
+void *dispatch_thread(void *arg)
+{
+	alarm_t **last, *alarm;
+	worker_t *worker;
+	throttle_verdict_t verdict;
+	struct timespec wake;
+	int assigned_type[DISPATCH_BATCH];
+	long assigned_thread[DISPATCH_BATCH];
+	int assigned, i, status;
+	time_t now;
+
+	(void)arg;
+	ALLOC_GUARD_ENTER ();
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	while (1) {
+		assigned = 0;
+		now = alarm_clock_now ();
+		last = &alarm_list;
+		while ((alarm = *last) != NULL && assigned < DISPATCH_BATCH) {
+			worker = worker_find(alarm->message_type);
+			if (worker == NULL) {
+				last = &alarm->link;
+				continue;
+			}
+			*last = alarm->link;
+			alarm->link = NULL;
+			alarm->worker = worker;
+			alarm->status = (long)worker->thread_id;
+			alarm->time = now + alarm->seconds;
+			alarm->node.key = alarm->time;
+			alarm_take(alarm, &dispatch_queue);
+			status = timerq_insert(&dispatch_queue, &alarm->node);
+			if (status != 0)
+			err_abort (status, "Insert timer queue");
+			worker->pending++;
+			assigned_type[assigned] = alarm->message_type;
+			assigned_thread[assigned++] = (long)worker->thread_id;
+		}
+		/*
+		 *Announce bindings before any of those alarms can be posted,
+		 *so each worker's output starts with its assignment
+		 */
+		if (assigned > 0) {
+			status = sched_lock_unlock (&alarm_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock mutex");
+			status = pthread_mutex_lock (&print_mutex);
+			if (status != 0)
+			err_abort (status, "Lock print mutex");
+			for (i = 0; i < assigned; i++)
+				printf("Alarm Request With Message Type (%d) Assigned to Alarm Thread %ld at %ld: Type %c\n",assigned_type[i],assigned_thread[i],(long)alarm_clock_now (),'A');
+			status = pthread_mutex_unlock (&print_mutex);
+			if (status != 0)
+			err_abort (status, "Unlock print mutex");
+			status = sched_lock_lock (&alarm_mutex);
+			if (status != 0)
+			err_abort (status, "Lock mutex");
+		}
+		while ((alarm = (alarm_t *)timerq_peek(&dispatch_queue)) != NULL
+				&& alarm->time <= now) {
+			timerq_remove(&dispatch_queue, &alarm->node);
+			verdict = alarm_throttle(alarm, now);
+			if (verdict == THROTTLE_DELAY) {
+				status = timerq_insert(&dispatch_queue, &alarm->node);
+				if (status != 0)
+				err_abort (status, "Insert timer queue");
+				continue;
+			}
+			alarm_index_remove(alarm);
+			alarm->queue = NULL;
+			alarm->worker->pending--;
+			if (verdict == THROTTLE_DROP)
+				pool_put(&alarm_pool, alarm);
+			else
+				worker_post(alarm->worker, alarm);
+		}
+		/*
+		 *Due alarms are posted on every pass, or a steady stream of
+		 *new ones to bind would starve them. Alarms that arrived while
+		 *the bindings were printed did not find this thread waiting,
+		 *so look at alarm_list again rather than sleep
+		 */
+		if (assigned > 0)
+			continue;
+		if (alarm == NULL) {
+			status = sched_lock_wait(&alarm_mutex, &alarm_cond);
+		} else {
+			alarm_clock_abstime(alarm->time, &wake);
+			status = sched_lock_timedwait(&alarm_mutex, &alarm_cond, &wake);
+			if (status == ETIMEDOUT)
+				status = 0;
+		}
+		if (status != 0)
+		err_abort (status, "Wait on cond");
+	}
+	return NULL;
+}
+
+/*
+ * A thread is stuck when it has an alarm due and has made no progress
+ * for watchdog_threshold seconds since the later of the alarm falling
+ * due and its last progress: it is blocked writing output or not being
+ * scheduled.
+ */
+int watch_stuck(time_t now, time_t due, time_t progress)
+{
+	return now - (due > progress ? due : progress) >= watchdog_threshold;
+}
+
+/*
+ * Watchdog pass over the polling threads. Each stuck thread is
+ * reported once until it catches up, and with -W its queue is handed
+ * to the least loaded sibling of the same type that is keeping up; an
+ * idle sibling must then be woken by the caller. Requires alarm_mutex.
+ */
+int watch_threads(time_t now, watch_report_t *reports)
+{
+	thread_watch_t *watch, *sibling, *best;
+	timerq_node_t *head;
+	alarm_t *alarm;
+	int n = 0;
+
+	for (watch = watch_list; watch != NULL && n < WATCHDOG_REPORTS; watch = watch->link) {
+		head = timerq_peek(&watch->queue);
+		if (head == NULL || head->key > now || !watch_stuck(now, head->key, watch->progress)) {
+			watch->overdue = 0;
+			continue;
+		}
+		if (watch->overdue)
+			continue;
+		watch->overdue = 1;
+		reports[n].thread = (long)watch->thread_id;
+		type_label(watch->message_type, watch->types, reports[n].type, sizeof (reports[n].type));
+		reports[n].late = now - head->key;
+		reports[n].waiting = watch->queue.count;
+		reports[n].progress = watch->progress;
+		reports[n].moved = 0;
+		best = NULL;
+		if (watchdog_redistribute) {
+			for (sibling = watch_list; sibling != NULL; sibling = sibling->link) {
+				if (sibling == watch || sibling->overdue || sibling->parked
+						|| !same_types(sibling->message_type, sibling->types, watch->message_type, watch->types))
+					continue;
+				head = timerq_peek(&sibling->queue);
+				if (head != NULL && head->key <= now && watch_stuck(now, head->key, sibling->progress))
+					continue;
+				if (best == NULL || sibling->queue.count < best->queue.count)
+					best = sibling;
+			}
+		}
+		if (best != NULL) {
+			if (best->queue.count == 0)
+				best->progress = now;
+			while ((alarm = (alarm_t *)timerq_pop(&watch->queue)) != NULL) {
+				alarm->queue = &best->queue;
+				alarm->status = (long)best->thread_id;
+				if (timerq_insert(&best->queue, &alarm->node) != 0)
+				err_abort (ENOMEM, "Insert timer queue");
+				reports[n].moved++;
+			}
+			reports[n].sibling = (long)best->thread_id;
+		}
+		n++;
+	}
+	return n;
+}
+
+/*
+ * The EDF dispatch thread's start routine (a2 -m edf). Like
+ * dispatch_thread it takes alarms off alarm_list once some worker
+ * serves their type and sleeps until the earliest deadline, but it
+ * binds no alarm until it is due. Due alarms go to edf_ready in
+ * deadline order; each pass walks it from the earliest and posts every
+ * alarm a free worker may serve, and stops early once no worker is
+ * free. Workers wake it when they finish an alarm.
+ */
+void *edf_dispatch_thread(void *arg)
+{
+	alarm_t **last, *alarm, *kept;
+	worker_t *worker;
+	throttle_verdict_t verdict;
+	struct timespec wake;
+	int status;
+	time_t now;
+
+	(void)arg;
+	ALLOC_GUARD_ENTER ();
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	while (1) {
+		now = alarm_clock_now ();
+		last = &alarm_list;
+		while ((alarm = *last) != NULL) {
+			if (worker_find(alarm->message_type) == NULL) {
+				last = &alarm->link;
+				continue;
+			}
+			*last = alarm->link;
+			alarm->link = NULL;
+			alarm->worker = NULL;
+			alarm->time = now + alarm->seconds;
+			alarm->node.key = alarm->time;
+			alarm_take(alarm, &dispatch_queue);
+			status = timerq_insert(&dispatch_queue, &alarm->node);
+			if (status != 0)
+			err_abort (status, "Insert timer queue");
+		}
+
+		/*
+		 *Due alarms leave the index, as posted ones do, and join the
+		 *ready list; one rescheduled into the past may have to go in
+		 *ahead of the tail
+		 */
+		while ((alarm = (alarm_t *)timerq_peek(&dispatch_queue)) != NULL
+				&& alarm->time <= now) {
+			timerq_remove(&dispatch_queue, &alarm->node);
+			alarm_index_remove(alarm);
+			alarm->queue = NULL;
+			alarm->link = NULL;
+			memory_count(STATS_MEM_QUEUES, alarm, 1);
+			if (edf_ready_last == NULL) {
+				edf_ready = edf_ready_last = alarm;
+			} else if (edf_ready_last->time <= alarm->time) {
+				edf_ready_last->link = alarm;
+				edf_ready_last = alarm;
+			} else {
+				for (last = &edf_ready; (*last)->time <= alarm->time; last = &(*last)->link)
+					;
+				alarm->link = *last;
+				*last = alarm;
+			}
+		}
+
+		/*
+		 *The tail only goes if the walk gets that far
+		 */
+		last = &edf_ready;
+		kept = NULL;
+		while (edf_free > 0 && (alarm = *last) != NULL) {
+			worker = worker_find_free(alarm->message_type);
+			if (worker == NULL) {
+				kept = alarm;
+				last = &alarm->link;
+				continue;
+			}
+			*last = alarm->link;
+			memory_count(STATS_MEM_QUEUES, alarm, -1);
+			/*
+			 *An alarm over its type's rate limit goes back to the
+			 *dispatch queue, and the index, until its token's second
+			 */
+			verdict = alarm_throttle(alarm, now);
+			if (verdict == THROTTLE_DELAY) {
+				alarm->queue = &dispatch_queue;
+				alarm_index_add(alarm);
+				status = timerq_insert(&dispatch_queue, &alarm->node);
+				if (status != 0)
+				err_abort (status, "Insert timer queue");
+				continue;
+			} else if (verdict == THROTTLE_DROP) {
+				pool_put(&alarm_pool, alarm);
+				continue;
+			}
+			worker->busy = 1;
+			edf_free--;
+			alarm->worker = worker;
+			alarm->status = (long)worker->thread_id;
+			worker_post(worker, alarm);
+		}
+		if (*last == NULL)
+			edf_ready_last = kept;
+
+		alarm = (alarm_t *)timerq_peek(&dispatch_queue);
+		if (alarm == NULL) {
+			status = sched_lock_wait(&alarm_mutex, &alarm_cond);
+		} else {
+			alarm_clock_abstime(alarm->time, &wake);
+			status = sched_lock_timedwait(&alarm_mutex, &alarm_cond, &wake);
+			if (status == ETIMEDOUT)
+				status = 0;
+		}
+		if (status != 0)
+		err_abort (status, "Wait on cond");
+	}
+	return NULL;
+}
+
+/*
+ * EDF: drop the alarms of a terminated type that no worker serves any
+ * more, from the dispatch queue and the ready list. Requires
+ * alarm_mutex.
+ */
+void edf_drop_type(int message_type)
+{
+	alarm_t **bucket, **last, *alarm;
+	int i;
+
+	if (worker_find(message_type) != NULL)
+		return;
+	for (i = 0; i < ALARM_INDEX_BUCKETS; i++) {
+		bucket = &alarm_index[i];
+		while ((alarm = *bucket) != NULL) {
+			if (alarm->queue == &dispatch_queue && alarm->message_type == message_type) {
+				*bucket = alarm->id_link;
+				alarm_count(alarm, -1);
+				timerq_remove(&dispatch_queue, &alarm->node);
+				pool_put(&alarm_pool, alarm);
+			} else
+				bucket = &alarm->id_link;
+		}
+	}
+	edf_ready_last = NULL;
+	for (last = &edf_ready; (alarm = *last) != NULL; ) {
+		if (alarm->message_type == message_type) {
+			*last = alarm->link;
+			memory_count(STATS_MEM_QUEUES, alarm, -1);
+			pool_put(&alarm_pool, alarm);
+		} else {
+			edf_ready_last = alarm;
+			last = &alarm->link;
+		}
+	}
+}
+
+/*
+ * Watchdog pass over the dispatch workers, where the due alarms are
+ * the ones in a worker's mailbox. With -W a stuck worker's mailbox,
+ * and the alarms still bound to it in the dispatch queue, go to the
+ * least loaded sibling, whose progress clock restarts so it is not
+ * blamed for alarms that were already late. Requires alarm_mutex.
+ */
+int watch_workers(time_t now, watch_report_t *reports)
+{
+	worker_t *worker, *sibling, *best;
+	alarm_t *alarm;
+	int n = 0, b, i, status;
+
+	for (b = 0; b <= WORKER_MULTI && n < WATCHDOG_REPORTS; b++) {
+		for (worker = worker_index[b]; worker != NULL && n < WATCHDOG_REPORTS; worker = worker->link) {
+			status = pthread_mutex_lock (&worker->mutex);
+			if (status != 0)
+			err_abort (status, "Lock worker mutex");
+			if (worker->mailbox == NULL || !watch_stuck(now, worker->mailbox->time, worker->progress)) {
+				worker->overdue = 0;
+			} else if (!worker->overdue) {
+				worker->overdue = 1;
+				reports[n].thread = (long)worker->thread_id;
+				type_label(worker->message_type, worker->types, reports[n].type, sizeof (reports[n].type));
+				reports[n].late = now - worker->mailbox->time;
+				reports[n].waiting = worker->mailbox_count + worker->pending;
+				reports[n].progress = worker->progress;
+				reports[n].moved = 0;
+				best = NULL;
+				/*
+				 *Under EDF nothing more is posted to a busy worker, so
+				 *its siblings take the type's later alarms anyway
+				 */
+				if (watchdog_redistribute && !edf_mode) {
+					for (sibling = worker_index[b]; sibling != NULL; sibling = sibling->link)
+						if (sibling != worker && !sibling->overdue
+								&& same_types(sibling->message_type, sibling->types,
+									worker->message_type, worker->types)
+								&& (best == NULL || sibling->pending < best->pending))
+							best = sibling;
+				}
+				if (best != NULL) {
+					/*
+					 *The watchdog is the only thread that holds two mailbox
+					 *mutexes at once, so taking the sibling's cannot deadlock
+					 */
+					status = pthread_mutex_lock (&best->mutex);
+					if (status != 0)
+					err_abort (status, "Lock worker mutex");
+					if (best->mailbox == NULL)
+						best->progress = now;
+					if (worker->mailbox != NULL) {
+						*best->mailbox_tail = worker->mailbox;
+						best->mailbox_tail = worker->mailbox_tail;
+						best->mailbox_count += worker->mailbox_count;
+						reports[n].moved = worker->mailbox_count;
+						worker->mailbox = NULL;
+						worker->mailbox_tail = &worker->mailbox;
+						worker->mailbox_count = 0;
+					}
+					status = pthread_cond_signal (&best->cond);
+					if (status != 0)
+					err_abort (status, "Signal worker");
+					status = pthread_mutex_unlock (&best->mutex);
+					if (status != 0)
+					err_abort (status, "Unlock worker mutex");
+					for (i = 0; i < ALARM_INDEX_BUCKETS; i++)
+						for (alarm = alarm_index[i]; alarm != NULL; alarm = alarm->id_link)
+							if (alarm->queue == &dispatch_queue && alarm->worker == worker) {
+								alarm->worker = best;
+								alarm->status = (long)best->thread_id;
+								worker->pending--;
+								best->pending++;
+								reports[n].moved++;
+							}
+					reports[n].sibling = (long)best->thread_id;
+				}
+				n++;
+			}
+			status = pthread_mutex_unlock (&worker->mutex);
+			if (status != 0)
+			err_abort (status, "Unlock worker mutex");
+		}
+	}
+	return n;
+}
+
+/*
+ * The watchdog's start routine. Once a second of alarm time it checks
+ * every alarm thread and reports the late ones on stderr, which does
+ * not go through print_mutex, so a thread stuck writing stdout cannot
+ * hold the reports up too.
+ */
+void *watchdog_thread(void *arg)
+{
+	watch_report_t reports[WATCHDOG_REPORTS];
+	struct timespec wake;
+	time_t now;
+	int n, i, moved, status;
+
+	(void)arg;
+	ALLOC_GUARD_ENTER ();
+	while (1) {
+		alarm_clock_abstime(alarm_clock_now () + 1, &wake);
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake, NULL) == EINTR)
+			;
+		status = sched_lock_lock (&alarm_mutex);
+		if (status != 0)
+		err_abort (status, "Lock mutex");
+		now = alarm_clock_now ();
+		n = dispatch_mode ? watch_workers(now, reports) : watch_threads(now, reports);
+		status = sched_lock_unlock (&alarm_mutex);
+		if (status != 0)
+		err_abort (status, "Unlock mutex");
+		moved = 0;
+		for (i = 0; i < n; i++)
+			moved += reports[i].moved > 0;
+		if (moved && !dispatch_mode) {
+			status = sched_lock_broadcast(&alarm_mutex, &alarm_cond);
+			if (status != 0)
+			err_abort (status, "Broadcast cond");
+		}
+		for (i = 0; i < n; i++) {
+			STATS_ADD(overdue, 1);
+			fprintf(stderr, "Alarm Thread %ld For Message Type (%s) Overdue By %ld Seconds With %ld Alarms Waiting, Last Progress at %ld\n",
+				reports[i].thread, reports[i].type, reports[i].late,
+				reports[i].waiting, (long)reports[i].progress);
+			if (reports[i].moved > 0) {
+				STATS_ADD(redistributed, reports[i].moved);
+				fprintf(stderr, "%ld Alarms Moved From Alarm Thread %ld To Alarm Thread %ld\n",
+					reports[i].moved, reports[i].thread, reports[i].sibling);
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Threads a2 starts besides main and the alarm threads, and the stack
+ * each of them reserves, for "Stats: Memory". Main sets both before
+ * starting any thread.
+ */
+long helper_threads = 0;
+size_t thread_stack_size = 0;
+
+/*
+ * Add one alarm to the alarm list or thread queue row of memory.
+ */
+void memory_add_alarm(stats_memory_t *memory, int part, alarm_t *alarm)
+{
+	memory->objects[part]++;
+	memory->bytes[part] += sizeof (alarm_t);
+	memory->objects[STATS_MEM_MESSAGES]++;
+	memory->bytes[STATS_MEM_MESSAGES] += strlen(alarm->message) + 1;
+}
+
+/*
+ * Fill memory with what each part of a2 holds now. With walk, as for
+ * "Stats: Memory", the alarms are found in the index, the mailboxes
+ * and the EDF ready list; one being printed is in none of them.
+ * Without, as for the publisher, their rows are copied from the
+ * running totals in alarm_memory. Everything else is read off the
+ * threads. Requires alarm_mutex.
+ */
+void memory_collect(stats_memory_t *memory, int walk)
+{
+	thread_watch_t *watch;
+	worker_t *worker;
+	alarm_t *alarm;
+	long threads;
+	int b, i, part, status;
+
+	memset(memory, 0, sizeof (*memory));
+	if (walk) {
+		for (i = 0; i < ALARM_INDEX_BUCKETS; i++)
+			for (alarm = alarm_index[i]; alarm != NULL; alarm = alarm->id_link)
+				memory_add_alarm(memory, alarm->queue == NULL
+					? STATS_MEM_ALARM_LIST : STATS_MEM_QUEUES, alarm);
+		for (alarm = edf_ready; alarm != NULL; alarm = alarm->link)
+			memory_add_alarm(memory, STATS_MEM_QUEUES, alarm);
+	} else {
+		for (part = STATS_MEM_ALARM_LIST; part <= STATS_MEM_MESSAGES; part++) {
+			memory->objects[part] = __atomic_load_n(&alarm_memory.objects[part], __ATOMIC_RELAXED);
+			memory->bytes[part] = __atomic_load_n(&alarm_memory.bytes[part], __ATOMIC_RELAXED);
+		}
+	}
+	if (dispatch_mode)
+		memory->bytes[STATS_MEM_QUEUES] += timerq_footprint(&dispatch_queue);
+
+	for (watch = watch_list; watch != NULL; watch = watch->link) {
+		memory->objects[STATS_MEM_THREAD_NODES]++;
+		memory->bytes[STATS_MEM_THREAD_NODES] += sizeof (alarm_thread_t) + sizeof (thread_watch_t);
+		memory->bytes[STATS_MEM_QUEUES] += timerq_footprint(&watch->queue);
+	}
+	for (b = 0; b <= WORKER_MULTI; b++) {
+		for (worker = worker_index[b]; worker != NULL; worker = worker->link) {
+			memory->objects[STATS_MEM_THREAD_NODES]++;
+			memory->bytes[STATS_MEM_THREAD_NODES] += sizeof (alarm_thread_t) + sizeof (worker_t);
+			if (!walk)
+				continue;
+			status = pthread_mutex_lock (&worker->mutex);
+			if (status != 0)
+			err_abort (status, "Lock worker mutex");
+			for (alarm = worker->mailbox; alarm != NULL; alarm = alarm->link)
+				memory_add_alarm(memory, STATS_MEM_QUEUES, alarm);
+			status = pthread_mutex_unlock (&worker->mutex);
+			if (status != 0)
+			err_abort (status, "Unlock worker mutex");
+		}
+	}
+	/*
+	 *A parked worker's mailbox was emptied when it was parked
+	 */
+	memory->objects[STATS_MEM_THREAD_NODES] += parked_workers;
+	memory->bytes[STATS_MEM_THREAD_NODES] += parked_workers * (sizeof (alarm_thread_t) + sizeof (worker_t));
+
+	threads = memory->objects[STATS_MEM_THREAD_NODES] + helper_threads;
+	memory->objects[STATS_MEM_STACKS] = threads;
+	memory->bytes[STATS_MEM_STACKS] = threads * thread_stack_size;
+
+	/*
+	 *stdio gives stdout one buffer of about BUFSIZ; the rest are only
+	 *there with the option that sets them up
+	 */
+	memory->objects[STATS_MEM_OUTPUT] = 1;
+	memory->bytes[STATS_MEM_OUTPUT] = BUFSIZ;
+	if (output_ringed) {
+		memory->objects[STATS_MEM_OUTPUT]++;
+		memory->bytes[STATS_MEM_OUTPUT] += output_ring.size;
+	}
+	if (fire_order.window > 0) {
+		memory->objects[STATS_MEM_OUTPUT]++;
+		memory->bytes[STATS_MEM_OUTPUT] += REORDER_CAPACITY
+			* (sizeof (reorder_entry_t) + 2 * sizeof (reorder_entry_t *));
+	}
+	if (fire_summary.rate > 0) {
+		memory->objects[STATS_MEM_OUTPUT]++;
+		memory->bytes[STATS_MEM_OUTPUT] += SUMMARY_TYPES * sizeof (summary_type_t);
+	}
+	if (input_traced) {
+		memory->objects[STATS_MEM_OUTPUT]++;
+		memory->bytes[STATS_MEM_OUTPUT] += sizeof (input_trace.buffer);
+	}
+
+	memory->objects[STATS_MEM_POOL_FREE] = pool_free(&alarm_pool);
+	memory->bytes[STATS_MEM_POOL_FREE] = memory->objects[STATS_MEM_POOL_FREE] * sizeof (alarm_t);
+}
+
+/*
+ * With a2 -s <name> the publisher thread copies a2's state into the
+ * shared memory segment stats_segment once a second of real time (see
+ * shm_stats.h), however fast -v runs the alarm clock. It builds the
+ * snapshot under alarm_mutex, as the watchdog looks at the threads,
+ * from the threads, pending_tally and alarm_memory rather than the
+ * pending alarms, and writes the segment after letting go, so
+ * monitoring holds up the alarm paths for a walk of the threads once
+ * a second.
+ */
+shm_stats_t *stats_segment = NULL;
+pthread_t publisher_thread_id;
+
+void publish_thread(shm_stats_t *snapshot, long thread, int message_type, type_set_t *types,
+		int state, long queued, long late, thread_usage_t *usage)
+{
+	shm_thread_t *row;
+
+	if (snapshot->threads == SHM_STATS_THREADS) {
+		snapshot->threads_dropped++;
+		return;
+	}
+	row = &snapshot->thread[snapshot->threads++];
+	row->thread = thread;
+	if (state == SHM_THREAD_PARKED)
+		strcpy(row->type, "-");
+	else
+		type_label(message_type, types, row->type, sizeof (row->type));
+	row->state = state;
+	row->queued = queued;
+	row->late = late;
+	row->fired = USAGE_READ(*usage, fired);
+	row->passes = USAGE_READ(*usage, passes);
+}
+
+/*
+ * Note how late the alarm at the head of a timer queue is against its
+ * type, if it is due. The head is the most overdue alarm in its queue,
+ * so the heads give each type's lateness without a walk of the queues.
+ */
+void publish_late(shm_stats_t *snapshot, timerq_node_t *head, time_t now)
+{
+	shm_type_t *entry;
+
+	if (head == NULL || head->key > now)
+		return;
+	entry = shm_stats_type(snapshot, ((alarm_t *)head)->message_type);
+	if (entry != NULL && now - head->key > entry->late)
+		entry->late = now - head->key;
+}
+
+/*
+ * Fill snapshot with the state of every alarm thread and the alarms
+ * pending for each type. Requires alarm_mutex.
+ */
+void publish_collect(shm_stats_t *snapshot, time_t now)
+{
+	thread_watch_t *watch;
+	worker_t *worker;
+	timerq_node_t *head;
+	tally_type_t *tally;
+	shm_type_t *entry;
+	int b, state, status;
+	long i, late;
+
+	shm_stats_clear(snapshot);
+	snapshot->dispatch = dispatch_mode;
+	snapshot->published = now;
+	for (watch = watch_list; watch != NULL; watch = watch->link) {
+		head = timerq_peek(&watch->queue);
+		late = head != NULL && head->key <= now ? now - head->key : 0;
+		if (watch->parked)
+			state = SHM_THREAD_PARKED;
+		else if (watch->overdue)
+			state = SHM_THREAD_OVERDUE;
+		else if (head == NULL)
+			state = SHM_THREAD_IDLE;
+		else
+			state = head->key <= now ? SHM_THREAD_DUE : SHM_THREAD_TIMING;
+		publish_thread(snapshot, (long)watch->thread_id, watch->message_type, watch->types,
+			state, watch->queue.count, late, &watch->usage);
+	}
+	for (i = 0; i < pending_tally.count; i++) {
+		tally = &pending_tally.types[pending_tally.used[i]];
+		if (tally->waiting == 0 && tally->queued == 0)
+			continue;
+		entry = shm_stats_type(snapshot, tally->type);
+		if (entry == NULL)
+			continue;
+		entry->waiting = tally->waiting;
+		entry->queued = tally->queued;
+	}
+	for (watch = watch_list; watch != NULL; watch = watch->link)
+		publish_late(snapshot, timerq_peek(&watch->queue), now);
+	if (dispatch_mode)
+		publish_late(snapshot, timerq_peek(&dispatch_queue), now);
+	for (b = 0; b <= WORKER_MULTI; b++) {
+		for (worker = worker_index[b]; worker != NULL; worker = worker->link) {
+			status = pthread_mutex_lock (&worker->mutex);
+			if (status != 0)
+			err_abort (status, "Lock worker mutex");
+			late = worker->mailbox != NULL ? now - worker->mailbox->time : 0;
+			if (worker->overdue)
+				state = SHM_THREAD_OVERDUE;
+			else if (worker->mailbox != NULL)
+				state = SHM_THREAD_DUE;
+			else
+				state = worker->pending > 0 ? SHM_THREAD_TIMING : SHM_THREAD_IDLE;
+			publish_thread(snapshot, (long)worker->thread_id, worker->message_type, worker->types,
+				state, worker->pending + worker->mailbox_count, late, &worker->usage);
+			status = pthread_mutex_unlock (&worker->mutex);
+			if (status != 0)
+			err_abort (status, "Unlock worker mutex");
+		}
+	}
+}
+
+/*
+ * The publisher's start routine.
+ */
+void *publisher_thread(void *arg)
+{
+	static shm_stats_t snapshot;
+	struct timespec wake;
+	int status;
+
+	(void)arg;
+	ALLOC_GUARD_ENTER ();
+	clock_gettime(CLOCK_MONOTONIC, &wake);
+	while (1) {
+		status = sched_lock_lock (&alarm_mutex);
+		if (status != 0)
+		err_abort (status, "Lock mutex");
+		publish_collect(&snapshot, alarm_clock_now ());
+		memory_collect(&snapshot.memory, 0);
+		status = sched_lock_unlock (&alarm_mutex);
+		if (status != 0)
+		err_abort (status, "Unlock mutex");
+		snapshot.counters.accepted = STATS_READ(accepted);
+		snapshot.counters.suppressed = STATS_READ(suppressed);
+		snapshot.counters.fired = STATS_READ(fired);
+		snapshot.counters.overdue = STATS_READ(overdue);
+		snapshot.counters.redistributed = STATS_READ(redistributed);
+		snapshot.counters.reader_stalls = STATS_READ(reader_stalls);
+		snapshot.counters.copied = STATS_READ(copied);
+		snapshot.counters.reused = STATS_READ(reused);
+		snapshot.counters.throttled = STATS_READ(throttled);
+		snapshot.counters.dropped = STATS_READ(dropped);
+		snapshot.counters.out_dropped = STATS_READ(out_dropped);
+		snapshot.counters.out_spilled = STATS_READ(out_spilled);
+		snapshot.counters.out_waits = STATS_READ(out_waits);
+		snapshot.counters.unordered = STATS_READ(unordered);
+		snapshot.counters.summarised = STATS_READ(summarised);
+		shm_stats_publish(stats_segment, &snapshot);
+		wake.tv_sec++;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+			;
+	}
+	return NULL;
+}
+
+/*
+ * The order thread's start routine: once a second of alarm time, write
+ * out the fired alarms whose reorder window has passed.
+ */
+void *order_thread(void *arg)
+{
+	reorder_entry_t *entry;
+	struct timespec wake;
+	time_t now;
+	int status;
+
+	(void)arg;
+	ALLOC_GUARD_ENTER ();
+	while (1) {
+		status = pthread_mutex_lock (&print_mutex);
+		if (status != 0)
+		err_abort (status, "Lock print mutex");
+		now = alarm_clock_now ();
+		while ((entry = reorder_pop(&fire_order, now, 0)) != NULL) {
+			fputs(entry->text, stdout);
+			reorder_release(&fire_order, entry);
+		}
+		status = pthread_mutex_unlock (&print_mutex);
+		if (status != 0)
+		err_abort (status, "Unlock print mutex");
+		alarm_clock_abstime(now + 1, &wake);
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake, NULL) == EINTR)
+			;
+	}
+	return NULL;
+}
+
+/*
+ * Write out all the fired alarms held for ordering, due or not.
+ * Requires print_mutex.
+ */
+void order_drain(void)
+{
+	reorder_entry_t *entry;
+
+	while ((entry = reorder_pop(&fire_order, 0, 1)) != NULL) {
+		fputs(entry->text, stdout);
+		reorder_release(&fire_order, entry);
+	}
+}
+
+/*
+ * At exit, write out the fired alarms still held for ordering.
+ */
+void order_flush(void)
+{
+	pthread_mutex_lock (&print_mutex);
+	order_drain();
+	pthread_mutex_unlock (&print_mutex);
+}
+
+/*
+ * The summary thread's start routine: once a second of alarm time,
+ * report the fires folded for each bursting type.
+ */
+void *summary_thread(void *arg)
+{
+	struct timespec wake;
+	time_t now;
+	int status;
+
+	(void)arg;
+	ALLOC_GUARD_ENTER ();
+	while (1) {
+		status = pthread_mutex_lock (&print_mutex);
+		if (status != 0)
+		err_abort (status, "Lock print mutex");
+		now = alarm_clock_now ();
+		summary_report(&fire_summary, now, stdout);
+		status = pthread_mutex_unlock (&print_mutex);
+		if (status != 0)
+		err_abort (status, "Unlock print mutex");
+		alarm_clock_abstime(now + 1, &wake);
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wake, NULL) == EINTR)
+			;
+	}
+	return NULL;
+}
+
+/*
+ * At exit, report the fires folded since the summary thread last ran,
+ * including those of the second still going.
+ */
+void summary_flush(void)
+{
+	pthread_mutex_lock (&print_mutex);
+	summary_report(&fire_summary, alarm_clock_now () + 1, stdout);
+	pthread_mutex_unlock (&print_mutex);
+}
+
+typedef struct usage_row_tag {
+	long                thread;
+	int                 message_type;
+	char                type[TYPE_LABEL_SIZE];
+	unsigned long       fired;
+	unsigned long       wakeups;
+	unsigned long       passes;
+	long long           cpu_ns;     /* -1 if the clock cannot be read */
+} usage_row_t;
+
+long long thread_cpu_ns(pthread_t thread)
+{
+	clockid_t clock;
+	struct timespec cpu;
+
+	if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &cpu) != 0)
+		return -1;
+	return cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+}
+
+void usage_row_print(const char *name, const char *type, usage_row_t *row)
+{
+	printf("  %-20s %6s %8lu %10lu %12lu", name, type, row->fired, row->wakeups, row->passes);
+	if (row->cpu_ns < 0)
+		printf(" %10s %12s\n", "-", "-");
+	else if (row->fired == 0)
+		printf(" %10.1f %12s\n", row->cpu_ns / 1e6, "-");
+	else
+		printf(" %10.1f %12.1f\n", row->cpu_ns / 1e6, row->cpu_ns / 1e3 / row->fired);
+}
+
+int usage_row_by_type(const void *a, const void *b)
+{
+	const usage_row_t *x = a, *y = b;
+
+	if (x->message_type != y->message_type)
+		return (x->message_type > y->message_type) - (x->message_type < y->message_type);
+	return strcmp(x->type, y->type);
+}
+
+/*
+ * "Stats: Threads": each alarm thread's counters and CPU time, then the
+ * same summed per message type, then the threads that serve them all.
+ * The caller holds print_mutex.
+ */
+void thread_stats_report(time_t now)
+{
+	usage_row_t *rows, row, sum;
+	thread_watch_t *watch;
+	worker_t *worker;
+	alarm_thread_t *thread;
+	thread_usage_t *usage;
+	char name[32];
+	long n = 0, count = 0, i, first, threads;
+	int status, b;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	for (watch = watch_list; watch != NULL; watch = watch->link)
+		count++;
+	for (b = 0; b <= WORKER_MULTI; b++)
+		for (worker = worker_index[b]; worker != NULL; worker = worker->link)
+			count++;
+	rows = calloc(count + 1, sizeof (*rows));
+	if (rows == NULL)
+	errno_abort ("Allocate report");
+	for (watch = watch_list; watch != NULL; watch = watch->link) {
+		if (watch->parked)
+			continue;
+		rows[n].thread = (long)watch->thread_id;
+		rows[n].message_type = watch->message_type;
+		type_label(watch->message_type, watch->types, rows[n].type, sizeof (rows[n].type));
+		usage = &watch->usage;
+		rows[n].fired = USAGE_READ(*usage, fired);
+		rows[n].wakeups = USAGE_READ(*usage, wakeups);
+		rows[n].passes = USAGE_READ(*usage, passes);
+		rows[n++].cpu_ns = thread_cpu_ns(watch->thread_id);
+	}
+	for (b = 0; b <= WORKER_MULTI; b++) {
+		for (worker = worker_index[b]; worker != NULL; worker = worker->link, n++) {
+			rows[n].thread = (long)worker->thread_id;
+			rows[n].message_type = worker->message_type;
+			type_label(worker->message_type, worker->types, rows[n].type, sizeof (rows[n].type));
+			usage = &worker->usage;
+			rows[n].fired = USAGE_READ(*usage, fired);
+			rows[n].wakeups = USAGE_READ(*usage, wakeups);
+			rows[n].passes = USAGE_READ(*usage, passes);
+			rows[n].cpu_ns = thread_cpu_ns(worker->thread_id);
+		}
+	}
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+
+	printf("Thread Statistics at %ld:\n", (long)now);
+	printf("  %-20s %6s %8s %10s %12s %10s %12s\n", "thread", "type", "fired",
+		"wakeups", "passes", "cpu ms", "cpu us/fire");
+	for (i = 0; i < n; i++) {
+		snprintf(name, sizeof (name), "%ld", rows[i].thread);
+		usage_row_print(name, rows[i].type, &rows[i]);
+	}
+
+	printf("Message Type Statistics at %ld:\n", (long)now);
+	printf("  %-20s %6s %8s %10s %12s %10s %12s\n", "threads", "type", "fired",
+		"wakeups", "passes", "cpu ms", "cpu us/fire");
+	qsort(rows, n, sizeof (*rows), usage_row_by_type);
+	for (first = 0; first < n; first = i) {
+		memset(&sum, 0, sizeof (sum));
+		for (i = first; i < n && strcmp(rows[i].type, rows[first].type) == 0; i++) {
+			sum.fired += rows[i].fired;
+			sum.wakeups += rows[i].wakeups;
+			sum.passes += rows[i].passes;
+			if (rows[i].cpu_ns > 0)
+				sum.cpu_ns += rows[i].cpu_ns;
+		}
+		threads = i - first;
+		snprintf(name, sizeof (name), "%ld", threads);
+		usage_row_print(name, rows[first].type, &sum);
+	}
+	free(rows);
+
+	memset(&row, 0, sizeof (row));
+	row.cpu_ns = thread_cpu_ns(main_thread);
+	usage_row_print("main", "-", &row);
+	if (dispatch_mode) {
+		row.cpu_ns = thread_cpu_ns(dispatch_thread_id);
+		usage_row_print("dispatch", "-", &row);
+	}
+	if (watchdog_threshold > 0) {
+		row.cpu_ns = thread_cpu_ns(watchdog_thread_id);
+		usage_row_print("watchdog", "-", &row);
+	}
+	if (stats_segment != NULL) {
+		row.cpu_ns = thread_cpu_ns(publisher_thread_id);
+		usage_row_print("publisher", "-", &row);
+	}
+	if (idle_max > 0) {
+		row.cpu_ns = 0;
+		for (thread = idle_threads; thread != NULL; thread = thread->link)
+			row.cpu_ns += thread_cpu_ns(thread->thread_id);
+		snprintf(name, sizeof (name), "%ld parked", idle_count);
+		usage_row_print(name, "-", &row);
+	}
+	row.cpu_ns = __atomic_load_n(&retired_cpu_ns, __ATOMIC_RELAXED);
+	snprintf(name, sizeof (name), "%lu terminated", __atomic_load_n(&retired_threads, __ATOMIC_RELAXED));
+	usage_row_print(name, "-", &row);
+}
+
+//Main Function, or Main thread
+/*
+ * At exit, get what is still in the output ring written before the
+ * process goes.
+ */
+void output_flush(void)
+{
+	fflush(stdout);
+	out_ring_stop(&output_ring);
+}
+
+/*
+ * At exit, write out the end of the trace.
+ */
+void trace_flush(void)
+{
+	int status;
+
+	status = pthread_mutex_lock(&trace_mutex);
+	if (status != 0)
+	err_abort(status, "Lock trace mutex");
+	trace_stopped = 1;
+	status = trace_close(&input_trace);
+	if (status != 0)
+		fprintf(stderr, "Close trace: %s\n", strerror(status));
+	status = pthread_mutex_unlock(&trace_mutex);
+	if (status != 0)
+	err_abort(status, "Unlock trace mutex");
+}
+
+/*
+ * With -T, write out the trace every TRACE_SYNC seconds, so a capture
+ * that is killed loses at most the commands of the last one. SIGINT
+ * and SIGTERM, which main blocks for every thread, are taken here and
+ * end a2 through exit, whose handlers close the trace and flush the
+ * rest of the output.
+ */
+void *trace_thread(void *arg)
+{
+	struct timespec period = { TRACE_SYNC, 0 };
+	sigset_t signals;
+	int sig, status;
+
+	(void)arg;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	while (1) {
+		sig = sigtimedwait(&signals, NULL, &period);
+		if (sig == SIGINT || sig == SIGTERM)
+			exit(128 + sig);
+		status = pthread_mutex_lock(&trace_mutex);
+		if (status != 0)
+		err_abort(status, "Lock trace mutex");
+		if (!trace_stopped) {
+			status = trace_sync(&input_trace);
+			if (status != 0) {
+				fprintf(stderr, "Trace stopped: %s\n", strerror(status));
+				trace_stopped = 1;
+			}
+		}
+		status = pthread_mutex_unlock(&trace_mutex);
+		if (status != 0)
+		err_abort(status, "Unlock trace mutex");
+	}
+	return NULL;
+}
+
+/*
+ * Where the last barrier left off, so each "Barrier:" summary covers
+ * the alarms since the one before (or since main started reading).
+ */
+typedef struct barrier_mark_tag {
+	struct timespec     start;
+	long                pending;    /* alarms out of the pool */
+	unsigned long       accepted;
+	unsigned long       fired;
+	unsigned long       dropped;
+} barrier_mark_t;
+
+barrier_mark_t barrier_mark;
+
+void barrier_set(long pending)
+{
+	clock_gettime(CLOCK_MONOTONIC, &barrier_mark.start);
+	barrier_mark.pending = pending;
+	barrier_mark.accepted = STATS_READ(accepted);
+	barrier_mark.fired = STATS_READ(fired);
+	barrier_mark.dropped = STATS_READ(dropped);
+}
+
+/*
+ * "Barrier:", and EOF under -D: wait until every alarm accepted so far
+ * has fired or been dropped or removed, then print what happened since
+ * the last barrier and how long it took. Alarms of a type no thread
+ * serves would wait forever, so they are counted as unserved instead.
+ * Nothing polls: the wait is on the alarm pool, which every alarm
+ * goes back to when it is done with. Called by main, which owns the
+ * thread list, with no locks held.
+ */
+void barrier_wait(alarm_thread_t *threads)
+{
+	alarm_t *alarm;
+	alarm_thread_t *thread;
+	type_set_t *types;
+	struct timespec end;
+	unsigned long accepted, fired, dropped;
+	long unserved = 0, pending;
+	int status;
+
+	status = sched_lock_lock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Lock mutex");
+	for (alarm = alarm_list; alarm != NULL; alarm = alarm->link) {
+		for (thread = threads; thread != NULL; thread = thread->link) {
+			types = thread->worker != NULL ? thread->worker->types : thread->watch->types;
+			if (serves(thread->message_type, types, alarm->message_type))
+				break;
+		}
+		if (thread == NULL)
+			unserved++;
+	}
+	status = sched_lock_unlock (&alarm_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock mutex");
+
+	pending = pool_wait(&alarm_pool, unserved);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	status = pthread_mutex_lock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Lock print mutex");
+	order_drain();
+	accepted = STATS_READ(accepted) - barrier_mark.accepted;
+	fired = STATS_READ(fired) - barrier_mark.fired;
+	dropped = STATS_READ(dropped) - barrier_mark.dropped;
+	printf("Barrier Reached by Main Thread %ld at %ld: %lu Accepted, %lu Fired, %lu Dropped, %lu Removed, %ld Unserved in %.3f Seconds\n",
+		(long)pthread_self(), (long)alarm_clock_now (), accepted, fired, dropped,
+		barrier_mark.pending + accepted - pending - fired - dropped, pending,
+		(end.tv_sec - barrier_mark.start.tv_sec) + (end.tv_nsec - barrier_mark.start.tv_nsec) / 1e9);
+	fflush(stdout);
+	status = pthread_mutex_unlock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock print mutex");
+	barrier_set(pending);
+}
+
+int main (int argc, char *argv[])
+{
+	int status;
+	char input[256], *line;
+	char message[CMD_MESSAGE_MAX + 1];
+	cmd_text_t text;
+	unsigned int alarm_second;
+	unsigned long alarm_id;
+	alarm_t *alarm, **last, *next;
+	int message_type_len;
+	unsigned int message_type;
+	type_set_t *types;
+	char types_label[64];
+	const char *types_text;
+	int cmd_type;
+	stats_memory_t memory;
+	alarm_thread_t *head_thread, *last_thread, *thread_node;
+	head_thread = last_thread = thread_node = NULL;
+	pthread_t thread;
+	pthread_attr_t thread_attr;
+	sigset_t signals;
+	int option;
+	double clock_scale = 1.0;
+	long pool_size;
+	time_t dedup_window = 0;
+	long read_ahead = 0;
+	line_ring_t input_ring;
+	out_policy_t output_policy = OUT_BLOCK;
+	const char *spill_path = NULL;
+	long output_size = 0;
+	FILE *output;
+	time_t order_window = 0;
+	int drain_at_eof = 0;
+	long summary_rate = 0;
+
+	/*
+	 *-q selects the timer queue backend each alarm thread uses,
+	 *-v runs the alarm clock that many times faster than real time,
+	 *-p sizes the alarm pool and each thread's queue for that many alarms,
+	 *-d drops alarm requests repeated within that many seconds,
+	 *-l selects the kind of lock alarm_mutex is,
+	 *-m dispatch moves all deadlines into one dispatch thread, and
+	 *-m edf also leaves alarms unbound until they are due,
+	 *-w reports alarm threads whose alarms are that many seconds late,
+	 *-W also moves their alarms to a sibling thread of the same type,
+	 *-r reads up to that many lines of input ahead in a reader thread,
+	 *-k parks up to that many threads of terminated types for reuse,
+	 *-s publishes a2's state in the shared memory segment of that name,
+	 *-t limits how many alarms of a type fire each second,
+	 *-o sends output through a ring with that policy when it is full, and
+	 *-b sizes the ring, and
+	 *-O writes fired alarms in deadline order, holding each that many seconds,
+	 *-D waits at EOF for the pending alarms, as "Barrier:" does, and
+	 *-S summarises the fires of a type going over that many a second, and
+	 *-T records the commands main takes, with their arrival times, in a trace
+	 */
+	while ((option = getopt (argc, argv, "q:v:p:d:l:m:w:Wr:k:s:t:o:b:O:DS:T:")) != -1) {
+		switch (option) {
+		case 'q':
+			if (timerq_kind_parse (optarg, &timer_queue_kind) != 0) {
+				fprintf (stderr, "Unknown timer queue \"%s\" (list, heap, pairing, wheel)\n", optarg);
+				exit (1);
+			}
+			break;
+		case 'v':
+			clock_scale = atof (optarg);
+			if (clock_scale < 1.0) {
+				fprintf (stderr, "Clock scale must be at least 1\n");
+				exit (1);
+			}
+			break;
+		case 'p':
+			pool_size = atol (optarg);
+			if (pool_size < 1) {
+				fprintf (stderr, "Pool size must be positive\n");
+				exit (1);
+			}
+			status = pool_reserve (&alarm_pool, pool_size);
+			if (status != 0)
+				err_abort (status, "Reserve alarm pool");
+			timer_queue_reserve = pool_size;
+			break;
+		case 'd':
+			dedup_window = atol (optarg);
+			if (dedup_window < 1) {
+				fprintf (stderr, "Dedup window must be positive\n");
+				exit (1);
+			}
+			break;
+		case 'l':
+			if (sched_lock_kind_parse (optarg, &alarm_mutex.kind) != 0) {
+				fprintf (stderr, "Unknown lock \"%s\" (mutex, ticket, mcs)\n", optarg);
+				exit (1);
+			}
+			break;
+		case 'm':
+			dispatch_mode = edf_mode = 0;
+			if (strcmp (optarg, "dispatch") == 0)
+				dispatch_mode = 1;
+			else if (strcmp (optarg, "edf") == 0)
+				dispatch_mode = edf_mode = 1;
+			else if (strcmp (optarg, "poll") != 0) {
+				fprintf (stderr, "Unknown mode \"%s\" (poll, dispatch, edf)\n", optarg);
+				exit (1);
+			}
+			break;
+		case 'w':
+			watchdog_threshold = atol (optarg);
+			if (watchdog_threshold < 1) {
+				fprintf (stderr, "Watchdog threshold must be positive\n");
+				exit (1);
+			}
+			break;
+		case 'W':
+			watchdog_redistribute = 1;
+			break;
+		case 'r':
+			read_ahead = atol (optarg);
+			if (read_ahead < 1) {
+				fprintf (stderr, "Read-ahead depth must be positive\n");
+				exit (1);
+			}
+			break;
+		case 'k':
+			idle_max = atol (optarg);
+			if (idle_max < 0) {
+				fprintf (stderr, "Parked thread count must not be negative\n");
+				exit (1);
+			}
+			break;
+		case 's':
+			status = shm_stats_create (optarg, &stats_segment);
+			if (status != 0)
+				err_abort (status, "Create stats segment");
+			atexit (shm_stats_remove);
+			break;
+		case 't':
+			status = throttle_add (&fire_throttle, optarg);
+			if (status == -1) {
+				fprintf (stderr, "Bad rate limit \"%s\" (type[-type]:rate[:drop])\n", optarg);
+				exit (1);
+			}
+			if (status != 0)
+				err_abort (status, "Add rate limit");
+			break;
+		case 'o':
+			if (out_policy_parse (optarg, &output_policy, &spill_path) != 0) {
+				fprintf (stderr, "Unknown output policy \"%s\" (block, drop-oldest, drop-new, spill:FILE)\n", optarg);
+				exit (1);
+			}
+			output_ringed = 1;
+			break;
+		case 'b':
+			output_size = atol (optarg);
+			if (output_size < OUT_RING_MIN) {
+				fprintf (stderr, "Output ring must be at least %d bytes\n", OUT_RING_MIN);
+				exit (1);
+			}
+			break;
+		case 'O':
+			order_window = atol (optarg);
+			if (order_window < 1) {
+				fprintf (stderr, "Reorder window must be positive\n");
+				exit (1);
+			}
+			break;
+		case 'D':
+			drain_at_eof = 1;
+			break;
+		case 'S':
+			summary_rate = atol (optarg);
+			if (summary_rate < 1) {
+				fprintf (stderr, "Summary rate must be positive\n");
+				exit (1);
+			}
+			break;
+		case 'T':
+			status = trace_create (&input_trace, optarg);
+			if (status != 0) {
+				fprintf (stderr, "Cannot create trace \"%s\": %s\n", optarg, strerror (status));
+				exit (1);
+			}
+			input_traced = 1;
+			atexit (trace_flush);
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-q list|heap|pairing|wheel] [-v scale] [-p alarms] [-d seconds] [-l mutex|ticket|mcs] [-m poll|dispatch|edf] [-w seconds [-W]] [-r lines] [-k threads] [-s name] [-t type[-type]:rate[:drop]]... [-o block|drop-oldest|drop-new|spill:file [-b bytes]] [-O seconds] [-D] [-S rate] [-T file]\n", argv[0]);
+			exit (1);
+		}
+	}
+	alarm_clock_init (clock_scale);
+	main_thread = pthread_self ();
+	if (output_size > 0 && !output_ringed) {
+		fprintf (stderr, "-b needs an output policy (-o)\n");
+		exit (1);
+	}
+	/*
+	 *With a trace, SIGINT and SIGTERM go to the trace thread, so they
+	 *are blocked before any thread starts and inherits the mask
+	 */
+	if (input_traced) {
+		sigemptyset (&signals);
+		sigaddset (&signals, SIGINT);
+		sigaddset (&signals, SIGTERM);
+		status = pthread_sigmask (SIG_BLOCK, &signals, NULL);
+		if (status != 0)
+			err_abort (status, "Block signals");
+		status = pthread_create (&trace_thread_id, NULL, trace_thread, NULL);
+		if (status != 0)
+			err_abort (status, "Create trace thread");
+	}
+	helper_threads = output_ringed + (order_window > 0) + (summary_rate > 0) + dispatch_mode
+		+ (watchdog_threshold > 0) + (stats_segment != NULL) + (read_ahead > 0) + input_traced;
+	status = pthread_attr_init (&thread_attr);
+	if (status != 0)
+		err_abort (status, "Init thread attributes");
+	status = pthread_attr_getstacksize (&thread_attr, &thread_stack_size);
+	if (status != 0)
+		err_abort (status, "Get stack size");
+	pthread_attr_destroy (&thread_attr);
+	if (output_ringed) {
+		status = out_ring_start (&output_ring, fileno (stdout),
+			output_size > 0 ? output_size : 65536, output_policy, spill_path, &output);
+		if (status != 0)
+			err_abort (status, "Start output ring");
+		stdout = output;
+		atexit (output_flush);
+	}
+	status = reorder_init (&fire_order, order_window, REORDER_CAPACITY);
+	if (status != 0)
+		err_abort (status, "Init reorder buffer");
+	if (order_window > 0) {
+		status = pthread_create (&order_thread_id, NULL, order_thread, NULL);
+		if (status != 0)
+			err_abort (status, "Create order thread");
+		atexit (order_flush);
+	}
+	status = summary_init (&fire_summary, summary_rate);
+	if (status != 0)
+		err_abort (status, "Init summaries");
+	if (summary_rate > 0) {
+		status = pthread_create (&summary_thread_id, NULL, summary_thread, NULL);
+		if (status != 0)
+			err_abort (status, "Create summary thread");
+		atexit (summary_flush);
+	}
+	/*
+	 *An alarm is due when it is printed, so do not let it sit in the
+	 *stdio buffer when stdout is a pipe
+	 */
+	setvbuf (stdout, NULL, _IOLBF, 0);
+	status = tally_init (&pending_tally, stats_segment != NULL);
+	if (status != 0)
+		err_abort (status, "Init tallies");
+	memory_running = stats_segment != NULL;
+	status = dedup_init (&alarm_dedup, dedup_window, ALARM_DEDUP_CAPACITY);
+	if (status != 0)
+		err_abort (status, "Init dedup set");
+	if (dispatch_mode) {
+		status = timerq_init (&dispatch_queue, timer_queue_kind);
+		if (status != 0)
+			err_abort (status, "Init timer queue");
+		status = timerq_reserve (&dispatch_queue, timer_queue_reserve);
+		if (status != 0)
+			err_abort (status, "Reserve timer queue");
+		status = pthread_create (&dispatch_thread_id, NULL,
+			edf_mode ? edf_dispatch_thread : dispatch_thread, NULL);
+		if (status != 0)
+			err_abort (status, "Create dispatch thread");
+	}
+	if (watchdog_redistribute && watchdog_threshold == 0) {
+		fprintf (stderr, "-W needs a watchdog threshold (-w)\n");
+		exit (1);
+	}
+	if (watchdog_threshold > 0) {
+		status = pthread_create (&watchdog_thread_id, NULL, watchdog_thread, NULL);
+		if (status != 0)
+			err_abort (status, "Create watchdog thread");
+	}
+	if (stats_segment != NULL) {
+		status = pthread_create (&publisher_thread_id, NULL, publisher_thread, NULL);
+		if (status != 0)
+			err_abort (status, "Create publisher thread");
+	}
+	if (read_ahead > 0) {
+		status = line_ring_start (&input_ring, stdin, read_ahead);
+		if (status != 0)
+			err_abort (status, "Start input reader");
+	}
+	
+	barrier_set(0);
+	//Loop runs until terminated
+	while (1) {
+		printf ("Alarm> ");
+		line = read_ahead > 0 ? line_ring_get (&input_ring)
+				: fgets (input, sizeof (input), stdin);
+		if (line == NULL) {
+			if (drain_at_eof)
+				barrier_wait(head_thread);
+			exit (0);
+		}
+		if (strlen (line) <= 1) continue;
+		/*
+		 *A trace that cannot be written stops, rather than a2
+		 */
+		if (input_traced) {
+			status = pthread_mutex_lock (&trace_mutex);
+			if (status != 0)
+				err_abort (status, "Lock trace mutex");
+			if (!trace_stopped) {
+				status = trace_write (&input_trace, line);
+				if (status != 0) {
+					fprintf (stderr, "Trace stopped: %s\n", strerror (status));
+					trace_stopped = 1;
+				}
+			}
+			status = pthread_mutex_unlock (&trace_mutex);
+			if (status != 0)
+				err_abort (status, "Unlock trace mutex");
+		}
+
+
+		//Get Command Type
+		cmd_type = cmd_scan_parse(line, strlen(line), &message_type, &alarm_second, message, &alarm_id, &text);
+		switch(cmd_type){
+			//If Type B
+		case 1:{
+			/*
+			 *"MessageType(2,3,7)" or "MessageType(10-99)" creates one
+			 *thread serving the whole set; get_cmd_type only saw the
+			 *first type
+			 */
+			types_text = strstr(line, "MessageType(");
+			types = NULL;
+			if (types_text != NULL) {
+				status = type_set_parse(types_text + strlen("MessageType("), &types);
+				if (status == -1) {
+					fprintf (stderr, "Bad list of message types.\n");
+					break;
+				} else if (status != 0)
+				err_abort (status, "Parse message types");
+			}
+			if (types != NULL)
+			message_type = types->ranges[0].lo;
+			status = pthread_mutex_lock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Lock print mutex");
+
+				if (idle_threads != NULL) {
+				/*
+				 *Rebind a parked thread rather than create one
+				 */
+					thread_node = idle_threads;
+					idle_threads = thread_node->link;
+					idle_count--;
+					thread_node->link = NULL;
+					if (thread_node->worker != NULL)
+					worker_unpark(thread_node->worker, message_type, types);
+					else
+					thread_unpark(thread_node->watch, message_type, types);
+					thread = thread_node->thread_id;
+					STATS_ADD(reused, 1);
+				} else if (dispatch_mode) {
+					thread_node = (alarm_thread_t*)calloc(1,sizeof (alarm_thread_t));
+					if (thread_node == NULL)
+					errno_abort ("Allocate thread");
+				/*
+				 *A worker only needs its mailbox; it is registered once its
+				 *thread exists so the dispatch thread can bind to it
+				 */
+					worker_t *worker = (worker_t*)calloc(1,sizeof (worker_t));
+					if (worker == NULL)
+					errno_abort ("Allocate worker");
+					worker->message_type = message_type;
+					worker->types = types;
+					worker->mailbox_tail = &worker->mailbox;
+					worker->progress = alarm_clock_now ();
+					status = pthread_mutex_init (&worker->mutex, NULL);
+					if (status != 0)
+					err_abort (status, "Init worker mutex");
+					status = pthread_cond_init (&worker->cond, NULL);
+					if (status != 0)
+					err_abort (status, "Init worker cond");
+					status = pthread_create (&thread, NULL, worker_thread, (void *) worker);
+					if (status != 0)
+					err_abort (status, "Create alarm thread");
+					status = pthread_detach (thread);
+					if (status != 0)
+					err_abort (status, "Detach alarm thread");
+					worker->thread_id = thread;
+					worker_register(worker);
+					thread_node->worker = worker;
+				} else {
+					thread_node = (alarm_thread_t*)calloc(1,sizeof (alarm_thread_t));
+					if (thread_node == NULL)
+					errno_abort ("Allocate thread");
+			/*
+			 *Set up the thread's record, with its type and timer queue,
+			 *and publish it once the thread exists
+			 */
+					thread_watch_t *watch = (thread_watch_t*)calloc(1,sizeof (thread_watch_t));
+					if (watch == NULL)
+					errno_abort ("Allocate thread record");
+					watch->message_type = message_type;
+					watch->types = types;
+					watch->progress = alarm_clock_now ();
+					status = timerq_init(&watch->queue, timer_queue_kind);
+					if (status != 0)
+					err_abort (status, "Init timer queue");
+					status = timerq_reserve(&watch->queue, timer_queue_reserve);
+					if (status != 0)
+					err_abort (status, "Reserve timer queue");
+					status = pthread_cond_init (&watch->wake, NULL);
+					if (status != 0)
+					err_abort (status, "Init thread cond");
+					status = pthread_create (&thread, NULL, alarm_thread, (void *) watch);
+					if (status != 0)
+					err_abort (status, "Create alarm thread");
+					status = pthread_detach (thread);
+					if (status != 0)
+					err_abort (status, "Detach alarm thread");
+					status = sched_lock_lock (&alarm_mutex);
+					if (status != 0)
+					err_abort (status, "Lock mutex");
+					watch->thread_id = thread;
+					watch->link = watch_list;
+					watch_list = watch;
+					status = sched_lock_unlock (&alarm_mutex);
+					if (status != 0)
+					err_abort (status, "Unlock mutex");
+					thread_node->watch = watch;
+				}
+				/*
+		     *Insert thread to thread list
+		     */
+				thread_node->thread_id = thread;
+				thread_node->message_type = message_type;
+
+				if(head_thread == NULL){
+					head_thread = last_thread = thread_node;
+
+				}else
+				{
+					last_thread->link = thread_node;
+					last_thread = thread_node;
+				}
+
+
+				if (types != NULL) {
+					type_set_format(types, types_label, sizeof (types_label));
+					printf("New Alarm Thread %ld For Message Types (%s) Created at %ld: Type B\n", (long)thread, types_label, (long)alarm_clock_now ());
+				} else
+				printf("New Alarm Thread %ld For Message Type (%d) Created at %ld: Type B\n", (long)thread, message_type, (long)alarm_clock_now ());
+				status = pthread_mutex_unlock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock print mutex");
+
+				break;
+
+				// Type C
+			}case 2:{
+				types_text = strstr(line, "MessageType(");
+				types = NULL;
+				status = 0;
+				if (types_text != NULL)
+				status = type_set_parse(types_text + strlen("MessageType("), &types);
+				if (status == -1 || types != NULL) {
+					type_set_free(types);
+					fprintf (stderr, "Terminate_Thread takes a single message type.\n");
+					break;
+				} else if (status != 0)
+				err_abort (status, "Parse message types");
+				status = pthread_mutex_lock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Lock print mutex");
+				terminated_message_type = message_type;
+				int contains=0;
+				alarm_thread_t *temp_thread,*temp_thread_past;
+				type_set_t *thread_types;
+				/*
+				 *Remove thread of MessageType(x) from list, and cancel thread.
+				 *A thread serving a set that holds other types as well
+				 *only stops serving this one
+         */
+				temp_thread_past=NULL;
+				for(temp_thread= head_thread; temp_thread!=NULL;){
+					thread_types = temp_thread->worker != NULL
+						? temp_thread->worker->types : temp_thread->watch->types;
+					if (serves(temp_thread->message_type, thread_types, terminated_message_type)
+							&& thread_types != NULL
+							&& !type_set_is(thread_types, terminated_message_type)) {
+						contains=1;
+						if (temp_thread->worker != NULL) {
+							worker_drop_type(temp_thread->worker, terminated_message_type);
+							temp_thread->message_type = temp_thread->worker->message_type;
+						} else {
+							thread_drop_type(temp_thread->watch, terminated_message_type);
+							temp_thread->message_type = temp_thread->watch->message_type;
+						}
+						temp_thread_past=temp_thread;
+						temp_thread = (temp_thread->link);
+					}else if(serves(temp_thread->message_type, thread_types, terminated_message_type)){
+						contains=1;
+						/*
+     				 *Remove thread from linked list, then park it for reuse
+     				 *or terminate it. A worker is retired first so the
+     				 *dispatch thread lets go of it
+     				 */
+						if(head_thread==temp_thread)
+						head_thread=temp_thread->link;
+						else
+						temp_thread_past->link=temp_thread->link;
+						if (idle_count < idle_max) {
+							if (temp_thread->worker != NULL)
+							worker_park(temp_thread->worker);
+							else
+							thread_park(temp_thread->watch);
+							temp_thread->link = idle_threads;
+							idle_threads = temp_thread;
+							idle_count++;
+						} else {
+							if (temp_thread->worker != NULL)
+							worker_retire(temp_thread->worker);
+							pthread_cancel(temp_thread->thread_id);
+							free(temp_thread);
+						}
+						if(temp_thread_past==NULL){
+							temp_thread=head_thread;
+
+						}
+						else{
+							temp_thread=temp_thread_past->link;
+						}
+
+
+					}
+					else{
+						temp_thread_past=temp_thread;
+						temp_thread = (temp_thread->link);
+
+					}
+				}
+
+
+				/*
+				 *remove the alarms with specified MessageType
+				 */
+
+				alarm_t *temp_alarm,*temp_alarm_past;
+				temp_alarm_past=NULL;
+				status = sched_lock_lock (&alarm_mutex);
+				if (status != 0)
+				err_abort (status, "Lock mutex");
+				for(temp_alarm= alarm_list; temp_alarm!=NULL;){
+					if((temp_alarm->message_type)==terminated_message_type){
+						contains=1;
+						if(alarm_list==temp_alarm)
+						alarm_list=temp_alarm->link;
+						else
+						temp_alarm_past->link=temp_alarm->link;
+						alarm_index_remove(temp_alarm);
+						pool_put(&alarm_pool, temp_alarm);
+						if(temp_alarm_past==NULL){
+							temp_alarm=alarm_list;
+						}
+						else{
+							temp_alarm=temp_alarm_past->link;
+						}
+
+					}
+					else{
+						temp_alarm_past=temp_alarm;
+						temp_alarm = (temp_alarm->link);
+					}
+				}
+				if (edf_mode)
+				edf_drop_type(terminated_message_type);
+
+				status = sched_lock_unlock (&alarm_mutex);
+				if (status != 0)
+				err_abort (status, "Unlock mutex");
+
+				if (contains){
+					printf("All Alarm Threads For Message Type (%d) Terminated And All Messages of Message Type Removed at %ld: Type C\n",terminated_message_type,(long)alarm_clock_now () );
+				}
+
+				#ifdef DEBUG
+				alarm_thread_t *temp;
+				for(temp= head_thread; temp!=NULL && head_thread != NULL; temp= (temp ->link))
+				printf("Thread: %ld %d\n", temp->thread_id,temp->message_type);
+				printf("[list: ");
+				for(next = alarm_list; next != NULL; next = next->link)
+				printf("%d(%d)[\"%s\"] ", next->time,
+				next->time, next->message
+				printf("]\n");
+				#endif
+                status = pthread_mutex_unlock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Unlock print mutex");
+
+
+				break;
+
+
+				//Type A
+			}case 3:{
+					ALLOC_GUARD_ENTER ();
+					status = pthread_mutex_lock (&print_mutex);
+	if (status != 0)
+	err_abort (status, "Lock print mutex");
+
+				/*
+				* The message is copied once, from the input line
+				* straight into the alarm; only a line get_cmd_type
+				* parsed has been through message first
+				*/
+				alarm = (alarm_t*)pool_get (&alarm_pool);
+				if (alarm == NULL)
+				errno_abort ("Allocate alarm");
+				memcpy(alarm->message, text.text, text.len);
+				alarm->message[text.len] = '\0';
+				STATS_ADD(copied, text.text == message ? 2 * (text.len + 1) : text.len + 1);
+
+				/*
+				* A repeat of a recently accepted request never reaches
+				* the alarm list; it is only counted
+				*/
+				if (dedup_check(&alarm_dedup, alarm_second, message_type, alarm->message, alarm_clock_now ())) {
+					pool_put(&alarm_pool, alarm);
+					STATS_ADD(suppressed, 1);
+					printf("Duplicate Alarm Request With Message Type (%d) Suppressed by Main Thread %ld at %ld: Type A\n", message_type, (long)pthread_self(), (long)alarm_clock_now ());
+				} else {
+				alarm->seconds = alarm_second;
+				alarm->time = alarm_clock_now () + alarm->seconds;
+				alarm->message_type = message_type;
+				alarm->status = 0;
+				alarm->throttled = 0;
+				alarm->link = NULL;
+				alarm->queue = NULL;
+				alarm->id = next_alarm_id++;
+
+				/*
+				* Insert the new alarm into the list of alarms,
+				* sorted by Message Type
+				*/
+				alarm_insert(alarm);
+				STATS_ADD(accepted, 1);
+				printf("Alarm Request With Message Type (%d) Inserted by Main Thread %ld Into Alarm List at %ld: Type A\n", alarm->message_type, (long)pthread_self(), (long)alarm_clock_now ());
+				}
+			status = pthread_mutex_unlock (&print_mutex);
+	        if (status != 0)
+	        err_abort (status, "Unlock print mutex");
+				ALLOC_GUARD_EXIT ();
+				break;
+
+				//Type D
+			}case 4:{
+				ALLOC_GUARD_ENTER ();
+				status = pthread_mutex_lock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Lock print mutex");
+				if (alarm_reschedule(alarm_id, alarm_second) == 0)
+				printf("Alarm (%lu) Rescheduled To %u Seconds by Main Thread %ld at %ld: Type D\n", alarm_id, alarm_second, (long)pthread_self(), (long)alarm_clock_now ());
+				else
+				fprintf (stderr, "No pending alarm with ID %lu.\n", alarm_id);
+				status = pthread_mutex_unlock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Unlock print mutex");
+				ALLOC_GUARD_EXIT ();
+				break;
+
+			}case 5:{
+				status = pthread_mutex_lock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Lock print mutex");
+				stats_report(stdout, alarm_clock_now ());
+				status = pthread_mutex_unlock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Unlock print mutex");
+				break;
+
+			}case 6:{
+				status = pthread_mutex_lock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Lock print mutex");
+				thread_stats_report(alarm_clock_now ());
+				status = pthread_mutex_unlock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Unlock print mutex");
+				break;
+
+			}case 7:{
+				barrier_wait(head_thread);
+				break;
+
+			}case 8:{
+				status = sched_lock_lock (&alarm_mutex);
+				if (status != 0)
+				err_abort (status, "Lock mutex");
+				memory_collect(&memory, 1);
+				status = sched_lock_unlock (&alarm_mutex);
+				if (status != 0)
+				err_abort (status, "Unlock mutex");
+				status = pthread_mutex_lock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Lock print mutex");
+				stats_memory_report(stdout, &memory, alarm_clock_now ());
+				status = pthread_mutex_unlock (&print_mutex);
+				if (status != 0)
+				err_abort (status, "Unlock print mutex");
+				break;
+
+			}case -1:{
+				fprintf (stderr, "Bad command\n");
+				break;
+			}
+		}
+	}
+	
+
+	status=sched_yield();
+	if (status != 0)
+	errno_abort ("Thread Yield");
+}
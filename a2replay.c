@@ -0,0 +1,101 @@
+/*
+ * a2replay.c
+ * Feeds a trace captured with a2 -T (see trace.h) back as commands on
+ * standard output, to be piped into a2. By default each command is
+ * written when as much time has passed since the first as had when it
+ * was captured; -x divides those gaps by a speed-up, and -f writes the
+ * commands as fast as the reader takes them. Commands are scheduled
+ * from the start of the replay, not from the one before, so a slow
+ * reader does not push every later command back.
+ *
+ * -l lists the trace instead: each command with the seconds from the
+ * start of the capture at which it arrived.
+ *
+ * Usage: a2replay [-x speedup | -f | -l] trace
+ */
+#include <signal.h>
+#include <time.h>
+#include "errors.h"
+#include "trace.h"
+
+static void usage (const char *name)
+{
+	fprintf (stderr, "Usage: %s [-x speedup | -f | -l] trace\n", name);
+	exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+	static trace_t trace;
+	char line[TRACE_LINE];
+	struct timespec start, due;
+	unsigned long long at, ns;
+	double speedup = 1;
+	long count = 0;
+	int option, status, fast = 0, list = 0;
+
+	while ((option = getopt (argc, argv, "x:fl")) != -1) {
+		switch (option) {
+		case 'x':
+			speedup = atof (optarg);
+			if (speedup <= 0) {
+				fprintf (stderr, "Speed-up must be positive\n");
+				exit (1);
+			}
+			break;
+		case 'f':
+			fast = 1;
+			break;
+		case 'l':
+			list = 1;
+			break;
+		default:
+			usage (argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage (argv[0]);
+	status = trace_open (&trace, argv[optind]);
+	if (status != 0) {
+		fprintf (stderr, "Cannot read trace \"%s\": %s\n", argv[optind],
+			status == EINVAL ? "not an a2 trace" : strerror (status));
+		exit (1);
+	}
+	signal (SIGPIPE, SIG_IGN);
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	while ((status = trace_read (&trace, &at, line, sizeof (line))) == 0) {
+		count++;
+		if (list) {
+			printf ("%14.6f %s\n", at / 1e9, line);
+			continue;
+		}
+		if (!fast) {
+			/*
+			 *Let a2 see what is already written before waiting
+			 */
+			if (fflush (stdout) == EOF)
+				break;
+			ns = (unsigned long long)(at / speedup);
+			due.tv_sec = start.tv_sec + ns / 1000000000ULL;
+			due.tv_nsec = start.tv_nsec + ns % 1000000000ULL;
+			if (due.tv_nsec >= 1000000000) {
+				due.tv_sec++;
+				due.tv_nsec -= 1000000000;
+			}
+			while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+				;
+		}
+		if (printf ("%s\n", line) < 0)
+			break;
+	}
+	if (status == EINVAL)
+		fprintf (stderr, "Trace \"%s\" is corrupt after %ld commands\n", argv[optind], count);
+	else if (status != EOF)
+		fprintf (stderr, "Cannot read trace \"%s\" after %ld commands: %s\n", argv[optind],
+			count, strerror (status));
+	if (fflush (stdout) == EOF && errno == EPIPE)
+		fprintf (stderr, "Reader went away after %ld commands\n", count);
+	trace_close (&trace);
+	return status != EOF;
+}
@@ -0,0 +1,148 @@
+/*
+ * a2stat.c
+ * Displays the state a2 -s <name> publishes in shared memory (see
+ * shm_stats.h): the "Stats:" counters with the rates at which alarms
+ * are accepted and fired, the memory each part of a2 holds, every
+ * alarm thread with its state and how late it is, and the alarms
+ * waiting for each message type. It maps
+ * the segment read-only and takes a consistent copy each -i
+ * milliseconds, so a2 is never stopped or signalled to be looked at.
+ * Rates are per second of a2's alarm time, between two copies.
+ *
+ * Usage: a2stat [-i milliseconds] [-n count] name
+ */
+#include <signal.h>
+#include <time.h>
+#include "errors.h"
+#include "shm_stats.h"
+#include "stats.h"
+
+static int by_type (const void *a, const void *b)
+{
+	const shm_type_t *x = a, *y = b;
+
+	return (x->type > y->type) - (x->type < y->type);
+}
+
+/*
+ * Alarms the thread had fired in the previous copy, or -1 if it was
+ * not there.
+ */
+static long fired_before (const shm_stats_t *last, long thread)
+{
+	long i;
+
+	for (i = 0; i < last->threads; i++)
+		if (last->thread[i].thread == thread)
+			return (long)last->thread[i].fired;
+	return -1;
+}
+
+static void rate (char *buf, size_t size, double count, double seconds)
+{
+	if (seconds > 0 && count >= 0)
+		snprintf (buf, size, "%.1f", count / seconds);
+	else
+		snprintf (buf, size, "-");
+}
+
+static void display (const shm_stats_t *now, const shm_stats_t *last, long retries)
+{
+	const shm_thread_t *t;
+	double seconds = 0;
+	char accepted[32], fired[32];
+	long i, before;
+
+	if (last != NULL && now->generation > last->generation)
+		seconds = now->published - last->published;
+	printf ("a2 pid %ld, %s mode, snapshot %lu at %ld%s, %ld torn reads retried\n",
+		(long)now->pid, now->dispatch ? "dispatch" : "poll", now->generation,
+		(long)now->published, kill (now->pid, 0) == 0 || errno == EPERM ? "" : " (not running)",
+		retries);
+	stats = now->counters;
+	stats_report (stdout, now->published);
+	rate (accepted, sizeof (accepted),
+		last != NULL ? (double)now->counters.accepted - last->counters.accepted : -1, seconds);
+	rate (fired, sizeof (fired),
+		last != NULL ? (double)now->counters.fired - last->counters.fired : -1, seconds);
+	printf ("  accepted per second   %s\n", accepted);
+	printf ("  fired per second      %s\n", fired);
+	stats_memory_report (stdout, &now->memory, now->published);
+
+	printf ("Threads (%ld%s):\n", now->threads, now->threads_dropped ? ", more not shown" : "");
+	printf ("  %-20s %10s %8s %8s %6s %8s %8s %12s\n", "thread", "type", "state",
+		"queued", "late", "fired", "fired/s", "passes");
+	for (i = 0; i < now->threads; i++) {
+		t = &now->thread[i];
+		before = last != NULL ? fired_before (last, t->thread) : -1;
+		rate (fired, sizeof (fired), before >= 0 ? (double)t->fired - before : -1, seconds);
+		printf ("  %-20ld %10s %8s %8ld %6ld %8lu %8s %12lu\n", t->thread, t->type,
+			shm_stats_state_name (t->state), t->queued, t->late, t->fired, fired, t->passes);
+	}
+
+	printf ("Message Types (%ld%s):\n", now->types, now->types_dropped ? ", more not shown" : "");
+	printf ("  %-10s %8s %8s %6s\n", "type", "waiting", "queued", "late");
+	for (i = 0; i < now->types; i++)
+		printf ("  %-10d %8ld %8ld %6ld\n", now->type[i].type, now->type[i].waiting,
+			now->type[i].queued, now->type[i].late);
+}
+
+int main (int argc, char *argv[])
+{
+	static shm_stats_t copies[2];
+	const shm_stats_t *segment;
+	shm_stats_t *now, *last = NULL;
+	struct timespec interval;
+	long count = 0, shown, retries = 0, ms = 1000;
+	int option, status, live;
+
+	while ((option = getopt (argc, argv, "i:n:")) != -1) {
+		switch (option) {
+		case 'i':
+			ms = atol (optarg);
+			break;
+		case 'n':
+			count = atol (optarg);
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-i milliseconds] [-n count] name\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (optind != argc - 1 || ms < 1 || count < 0) {
+		fprintf (stderr, "Usage: %s [-i milliseconds] [-n count] name\n", argv[0]);
+		exit (1);
+	}
+	status = shm_stats_attach (argv[optind], &segment);
+	if (status != 0) {
+		fprintf (stderr, "Cannot read stats segment \"%s\": %s\n", argv[optind], strerror (status));
+		exit (1);
+	}
+
+	/*
+	 *Redraw in place when watching on a terminal; otherwise print one
+	 *copy after another
+	 */
+	live = isatty (1) && count != 1;
+	interval.tv_sec = ms / 1000;
+	interval.tv_nsec = ms % 1000 * 1000000;
+	for (shown = 0; count == 0 || shown < count; shown++) {
+		if (shown > 0)
+			nanosleep (&interval, NULL);
+		now = &copies[shown % 2];
+		status = shm_stats_read (segment, now, &retries);
+		if (status != 0) {
+			fprintf (stderr, "No consistent copy of \"%s\": %s\n", argv[optind], strerror (status));
+			exit (1);
+		}
+		qsort (now->type, now->types, sizeof (now->type[0]), by_type);
+		if (live)
+			printf ("\033[H\033[J");
+		else if (shown > 0)
+			printf ("\n");
+		display (now, last, retries);
+		fflush (stdout);
+		last = now;
+	}
+	return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * alarm_clock.c
+ * Real and virtual time for a2; see alarm_clock.h.
+ */
+#include "alarm_clock.h"
+#include "errors.h"
+
+static double clock_scale = 1.0;
+static time_t clock_epoch;
+static struct timespec clock_start;
+
+/*
+ * Select the clock. A scale of 1 (the default) reads the real time
+ * of day; anything larger starts the virtual clock. Call once from
+ * main before any alarm thread exists.
+ */
+void alarm_clock_init (double scale)
+{
+	clock_scale = scale;
+	clock_epoch = time (NULL);
+	if (clock_gettime (CLOCK_MONOTONIC, &clock_start) != 0)
+		errno_abort ("Read monotonic clock");
+}
+
+time_t alarm_clock_now (void)
+{
+	struct timespec now;
+	double elapsed;
+
+	if (clock_scale == 1.0)
+		return time (NULL);
+	if (clock_gettime (CLOCK_MONOTONIC, &now) != 0)
+		errno_abort ("Read monotonic clock");
+	elapsed = (now.tv_sec - clock_start.tv_sec)
+		+ (now.tv_nsec - clock_start.tv_nsec) / 1e9;
+	return clock_epoch + (time_t)(elapsed * clock_scale);
+}
+
+/*
+ * Convert a deadline on the alarm clock into the CLOCK_REALTIME
+ * instant at which it is reached, for pthread_cond_timedwait.
+ */
+void alarm_clock_abstime (time_t deadline, struct timespec *abstime)
+{
+	struct timespec now, real;
+	double remaining;
+
+	if (clock_scale == 1.0) {
+		abstime->tv_sec = deadline;
+		abstime->tv_nsec = 0;
+		return;
+	}
+	if (clock_gettime (CLOCK_MONOTONIC, &now) != 0)
+		errno_abort ("Read monotonic clock");
+	if (clock_gettime (CLOCK_REALTIME, &real) != 0)
+		errno_abort ("Read real time clock");
+	remaining = (deadline - clock_epoch) / clock_scale
+		- ((now.tv_sec - clock_start.tv_sec)
+		+ (now.tv_nsec - clock_start.tv_nsec) / 1e9);
+	if (remaining < 0)
+		remaining = 0;
+	abstime->tv_sec = real.tv_sec + (time_t)remaining;
+	abstime->tv_nsec = real.tv_nsec + (long)((remaining - (time_t)remaining) * 1e9);
+	if (abstime->tv_nsec >= 1000000000) {
+		abstime->tv_sec++;
+		abstime->tv_nsec -= 1000000000;
+	}
+}
@@ -0,0 +1,18 @@
+/*
+ * alarm_clock.h
+ * The clock every alarm deadline and timestamp in a2 is read from.
+ * By default it is the real time of day. With a2 -v <scale> it becomes
+ * a virtual clock that starts at the real time and then runs <scale>
+ * times faster, so scenario scripts with long delays replay in a
+ * fraction of the wall time (see bench/run_scenarios.sh).
+ */
+#ifndef __alarm_clock_h
+#define __alarm_clock_h
+
+#include <time.h>
+
+void alarm_clock_init (double scale);
+time_t alarm_clock_now (void);
+void alarm_clock_abstime (time_t deadline, struct timespec *abstime);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * alloc_check.h
+ * Marks the code that must not touch the heap once a2 is warmed up:
+ * inserting alarms, the alarm threads' loop and the output they do.
+ * When compiled -DALLOC_CHECK (the a2_alloccheck binary) the marks
+ * count nesting in a per-thread guard and alloc_check.c replaces
+ * malloc and friends with versions that abort if called while the
+ * guard is raised. Otherwise the marks expand to nothing.
+ */
+#ifndef __alloc_check_h
+#define __alloc_check_h
+
+#ifdef ALLOC_CHECK
+extern __thread int alloc_guard;
+# define ALLOC_GUARD_ENTER()    (alloc_guard++)
+# define ALLOC_GUARD_EXIT()     (alloc_guard--)
+# define ALLOC_GUARD_CLEAR()    (alloc_guard = 0)
+#else
+# define ALLOC_GUARD_ENTER()
+# define ALLOC_GUARD_EXIT()
+# define ALLOC_GUARD_CLEAR()
+#endif
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * alarm_baseline.c
+ * The designs a2 grew out of, kept as baselines for the benchmarks.
+ * It reads the same commands as a2, parsed by the same get_cmd_type,
+ * and prints fired alarms in the same form, but schedules them the way
+ * Butenhof's original programs did:
+ *
+ *   thread  alarm_thread.c: a detached thread for every alarm, which
+ *           sleeps until the alarm is due, prints it and exits
+ *   cond    alarm_cond.c: one alarm thread takes alarms in deadline
+ *           order from a sorted list, waiting on a condition variable
+ *           that main signals when a new alarm is due sooner
+ *
+ * Neither has message type threads: Create_Thread and Terminate_Thread
+ * are accepted and ignored, and every alarm fires whatever its type.
+ * Commands the baselines have no counterpart for are rejected. -v runs
+ * them on a2's virtual clock, and -D waits at EOF for the pending
+ * alarms as a2 -D does.
+ *
+ * Usage: alarm_baseline [-e thread|cond] [-v scale] [-D]
+ */
+#include <pthread.h>
+#include <time.h>
+#include "errors.h"
+#include "alarm_clock.h"
+#include "command.h"
+
+typedef struct alarm_tag {
+	struct alarm_tag    *link;
+	int                 seconds;
+	time_t              time;       /* alarm clock deadline */
+	int                 message_type;
+	char                message[CMD_MESSAGE_MAX + 1];
+} alarm_t;
+
+static pthread_mutex_t alarm_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t alarm_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+static alarm_t *alarm_list = NULL;
+static time_t current_alarm = 0;
+static long pending = 0;            /* accepted and not yet printed */
+
+/*
+ * Print a due alarm and count it out of pending.
+ */
+static void alarm_fire (alarm_t *alarm)
+{
+	int status;
+
+	status = pthread_mutex_lock (&print_mutex);
+	if (status != 0)
+		err_abort (status, "Lock print mutex");
+	printf ("(%d) %s\n", alarm->seconds, alarm->message);
+	printf ("Alarm With Message Type (%d) Printed by Alarm Thread %ld at %d: Type %c \n",
+		alarm->message_type, (long)pthread_self (), (int)alarm_clock_now (), 'A');
+	status = pthread_mutex_unlock (&print_mutex);
+	if (status != 0)
+		err_abort (status, "Unlock print mutex");
+	free (alarm);
+
+	status = pthread_mutex_lock (&alarm_mutex);
+	if (status != 0)
+		err_abort (status, "Lock mutex");
+	if (--pending == 0) {
+		status = pthread_cond_broadcast (&idle_cond);
+		if (status != 0)
+			err_abort (status, "Signal idle");
+	}
+	status = pthread_mutex_unlock (&alarm_mutex);
+	if (status != 0)
+		err_abort (status, "Unlock mutex");
+}
+
+/*
+ * thread engine: the alarm's own thread sleeps until it is due.
+ */
+static void *alarm_thread_one (void *arg)
+{
+	alarm_t *alarm = (alarm_t *)arg;
+	struct timespec abstime;
+
+	alarm_clock_abstime (alarm->time, &abstime);
+	while (clock_nanosleep (CLOCK_REALTIME, TIMER_ABSTIME, &abstime, NULL) == EINTR)
+		;
+	alarm_fire (alarm);
+	return NULL;
+}
+
+/*
+ * cond engine: insert an alarm into the list in deadline order and
+ * wake the alarm thread if it is due sooner than the alarm it waits
+ * for. Called with alarm_mutex locked.
+ */
+static void alarm_insert (alarm_t *alarm)
+{
+	alarm_t **last, *next;
+	int status;
+
+	last = &alarm_list;
+	next = *last;
+	while (next != NULL) {
+		if (next->time >= alarm->time) {
+			alarm->link = next;
+			*last = alarm;
+			break;
+		}
+		last = &next->link;
+		next = next->link;
+	}
+	if (next == NULL) {
+		*last = alarm;
+		alarm->link = NULL;
+	}
+	if (current_alarm == 0 || alarm->time < current_alarm) {
+		current_alarm = alarm->time;
+		status = pthread_cond_signal (&alarm_cond);
+		if (status != 0)
+			err_abort (status, "Signal cond");
+	}
+}
+
+/*
+ * cond engine: the one alarm thread.
+ */
+static void *alarm_thread_cond (void *arg)
+{
+	alarm_t *alarm;
+	struct timespec abstime;
+	int status, expired;
+
+	status = pthread_mutex_lock (&alarm_mutex);
+	if (status != 0)
+		err_abort (status, "Lock mutex");
+	while (1) {
+		current_alarm = 0;
+		while (alarm_list == NULL) {
+			status = pthread_cond_wait (&alarm_cond, &alarm_mutex);
+			if (status != 0)
+				err_abort (status, "Wait on cond");
+		}
+		alarm = alarm_list;
+		alarm_list = alarm->link;
+		expired = 0;
+		if (alarm->time > alarm_clock_now ()) {
+			alarm_clock_abstime (alarm->time, &abstime);
+			current_alarm = alarm->time;
+			while (current_alarm == alarm->time) {
+				status = pthread_cond_timedwait (&alarm_cond, &alarm_mutex, &abstime);
+				if (status == ETIMEDOUT) {
+					expired = 1;
+					break;
+				}
+				if (status != 0)
+					err_abort (status, "Cond timedwait");
+			}
+			if (!expired)
+				alarm_insert (alarm);
+		} else
+			expired = 1;
+		if (expired) {
+			status = pthread_mutex_unlock (&alarm_mutex);
+			if (status != 0)
+				err_abort (status, "Unlock mutex");
+			alarm_fire (alarm);
+			status = pthread_mutex_lock (&alarm_mutex);
+			if (status != 0)
+				err_abort (status, "Lock mutex");
+		}
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	char line[256], message[CMD_MESSAGE_MAX + 1];
+	unsigned int message_type, alarm_second;
+	unsigned long alarm_id;
+	const char *engine = "thread";
+	double scale = 1.0;
+	int option, status, cond_engine, drain_at_eof = 0;
+	alarm_t *alarm;
+	pthread_t thread;
+
+	while ((option = getopt (argc, argv, "e:v:D")) != -1) {
+		switch (option) {
+		case 'e':
+			engine = optarg;
+			break;
+		case 'v':
+			scale = atof (optarg);
+			break;
+		case 'D':
+			drain_at_eof = 1;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-e thread|cond] [-v scale] [-D]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (strcmp (engine, "thread") != 0 && strcmp (engine, "cond") != 0) {
+		fprintf (stderr, "Unknown engine \"%s\" (thread, cond)\n", engine);
+		exit (1);
+	}
+	if (scale < 1.0) {
+		fprintf (stderr, "Clock scale must be at least 1\n");
+		exit (1);
+	}
+	cond_engine = strcmp (engine, "cond") == 0;
+	alarm_clock_init (scale);
+	setvbuf (stdout, NULL, _IOLBF, 0);
+	if (cond_engine) {
+		status = pthread_create (&thread, NULL, alarm_thread_cond, NULL);
+		if (status != 0)
+			err_abort (status, "Create alarm thread");
+	}
+
+	while (1) {
+		printf ("Alarm> ");
+		if (fgets (line, sizeof (line), stdin) == NULL)
+			break;
+		if (strlen (line) <= 1)
+			continue;
+		switch (get_cmd_type (line, &message_type, &alarm_second, message, &alarm_id)) {
+		case 1:
+		case 2:
+			/*
+			 *There are no type threads to create or terminate
+			 */
+			break;
+		case 3:
+			alarm = (alarm_t *)malloc (sizeof (alarm_t));
+			if (alarm == NULL)
+				errno_abort ("Allocate alarm");
+			alarm->seconds = alarm_second;
+			alarm->message_type = message_type;
+			strcpy (alarm->message, message);
+
+			status = pthread_mutex_lock (&alarm_mutex);
+			if (status != 0)
+				err_abort (status, "Lock mutex");
+			alarm->time = alarm_clock_now () + alarm->seconds;
+			pending++;
+			if (cond_engine)
+				alarm_insert (alarm);
+			status = pthread_mutex_unlock (&alarm_mutex);
+			if (status != 0)
+				err_abort (status, "Unlock mutex");
+
+			status = pthread_mutex_lock (&print_mutex);
+			if (status != 0)
+				err_abort (status, "Lock print mutex");
+			printf ("Alarm Request With Message Type (%d) Inserted by Main Thread %ld Into Alarm List at %d: Type A\n",
+				alarm->message_type, (long)pthread_self (), (int)alarm_clock_now ());
+			status = pthread_mutex_unlock (&print_mutex);
+			if (status != 0)
+				err_abort (status, "Unlock print mutex");
+
+			if (!cond_engine) {
+				status = pthread_create (&thread, NULL, alarm_thread_one, alarm);
+				if (status != 0)
+					err_abort (status, "Create alarm thread");
+				status = pthread_detach (thread);
+				if (status != 0)
+					err_abort (status, "Detach alarm thread");
+			}
+			break;
+		case -1:
+			break;
+		default:
+			fprintf (stderr, "The %s baseline does not support this command.\n", engine);
+		}
+	}
+
+	if (drain_at_eof) {
+		status = pthread_mutex_lock (&alarm_mutex);
+		if (status != 0)
+			err_abort (status, "Lock mutex");
+		while (pending > 0) {
+			status = pthread_cond_wait (&idle_cond, &alarm_mutex);
+			if (status != 0)
+				err_abort (status, "Wait for idle");
+		}
+		status = pthread_mutex_unlock (&alarm_mutex);
+		if (status != 0)
+			err_abort (status, "Unlock mutex");
+	}
+	return 0;
+}
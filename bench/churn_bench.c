@@ -0,0 +1,171 @@
+/*
+ * churn_bench.c
+ * Create_Thread/Terminate_Thread churn. For each parking limit it
+ * starts a2 -k <limit>, feeds it -n cycles of creating and terminating
+ * a thread for one message type and samples the process's resident
+ * set and thread count -s times along the way.
+ *
+ * With -k 0 every cycle creates a thread and cancels it; with -k 1
+ * the thread is parked and rebound, so after the first cycle no
+ * thread is created at all. It reports cycles per second, the RSS at
+ * the first and last samples and at most, the most threads a2 had at
+ * any sample, and the CPU time a2 used.
+ *
+ * Usage: churn_bench [-n cycles] [-k limit] [-s samples] [-m mode] [-a a2]
+ */
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "errors.h"
+
+typedef struct churn_result_tag {
+	double              seconds;
+	long                rss_first;  /* kB */
+	long                rss_last;
+	long                rss_max;
+	long                threads_max;
+	double              cpu;        /* user + system seconds */
+} churn_result_t;
+
+static double now_s (void)
+{
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Read VmRSS and Threads for pid from /proc. Either is left alone if
+ * it cannot be read.
+ */
+static void sample (pid_t pid, long *rss, long *threads)
+{
+	char path[64], line[256];
+	FILE *status;
+
+	snprintf (path, sizeof (path), "/proc/%ld/status", (long)pid);
+	status = fopen (path, "r");
+	if (status == NULL)
+		return;
+	while (fgets (line, sizeof (line), status) != NULL) {
+		sscanf (line, "VmRSS: %ld", rss);
+		sscanf (line, "Threads: %ld", threads);
+	}
+	fclose (status);
+}
+
+static void run (const char *a2, const char *mode, long limit, long cycles, long samples,
+	churn_result_t *result)
+{
+	static const char cycle[] = "Create_Thread: MessageType(1)\nTerminate_Thread: MessageType(1)\n";
+	char limit_arg[32];
+	struct rusage usage;
+	double start;
+	long i, rss = 0, threads = 0;
+	int in[2], status;
+	FILE *to;
+	pid_t pid;
+
+	if (pipe (in) != 0)
+		errno_abort ("Create pipe");
+	snprintf (limit_arg, sizeof (limit_arg), "%ld", limit);
+	fflush (stdout);
+	start = now_s ();
+	pid = fork ();
+	if (pid < 0)
+		errno_abort ("Fork");
+	if (pid == 0) {
+		dup2 (in[0], 0);
+		close (in[0]);
+		close (in[1]);
+		if (freopen ("/dev/null", "w", stdout) == NULL)
+			errno_abort ("Open /dev/null");
+		execl (a2, a2, "-m", mode, "-k", limit_arg, (char *)NULL);
+		errno_abort ("Exec a2");
+	}
+	close (in[0]);
+	to = fdopen (in[1], "w");
+	if (to == NULL)
+		errno_abort ("Open pipe");
+
+	memset (result, 0, sizeof (*result));
+	for (i = 0; i < cycles; i++) {
+		if (fputs (cycle, to) == EOF)
+			errno_abort ("Write to a2");
+		if ((i + 1) % (cycles / samples) == 0) {
+			fflush (to);
+			sample (pid, &rss, &threads);
+			if (result->rss_first == 0)
+				result->rss_first = rss;
+			if (rss > result->rss_max)
+				result->rss_max = rss;
+			if (threads > result->threads_max)
+				result->threads_max = threads;
+			result->rss_last = rss;
+		}
+	}
+	fclose (to);
+	if (wait4 (pid, &status, 0, &usage) < 0)
+		errno_abort ("Wait for a2");
+	result->seconds = now_s () - start;
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+		fprintf (stderr, "a2 -k %ld failed\n", limit);
+		exit (1);
+	}
+	result->cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+		+ usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+int main (int argc, char *argv[])
+{
+	churn_result_t result;
+	const char *a2 = "./a2", *mode = "poll";
+	long cycles = 100000, samples = 20, only = -1, limit;
+	int option;
+
+	while ((option = getopt (argc, argv, "n:k:s:m:a:")) != -1) {
+		switch (option) {
+		case 'n':
+			cycles = atol (optarg);
+			break;
+		case 'k':
+			only = atol (optarg);
+			break;
+		case 's':
+			samples = atol (optarg);
+			break;
+		case 'm':
+			mode = optarg;
+			break;
+		case 'a':
+			a2 = optarg;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-n cycles] [-k limit] [-s samples] [-m mode] [-a a2]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (cycles < 1 || samples < 1 || samples > cycles) {
+		fprintf (stderr, "-n and -s must be positive, with -s no more than -n\n");
+		exit (1);
+	}
+	signal (SIGPIPE, SIG_IGN);
+
+	printf ("churn benchmark: %ld create/terminate cycles, %s mode, %ld samples\n",
+		cycles, mode, samples);
+	printf ("%-8s %12s %12s %12s %12s %8s %8s\n", "parked", "cycles/s",
+		"rss first kB", "rss last kB", "rss max kB", "threads", "cpu s");
+	for (limit = 0; limit <= 1; limit++) {
+		if (only >= 0)
+			limit = only;
+		run (a2, mode, limit, cycles, samples, &result);
+		printf ("%-8ld %12.0f %12ld %12ld %12ld %8ld %8.2f\n", limit, cycles / result.seconds,
+			result.rss_first, result.rss_last, result.rss_max, result.threads_max, result.cpu);
+		if (only >= 0)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * dispatch_bench.c
+ * Compares a2's two alarm thread modes under many types and threads,
+ * against the designs a2 grew out of. For each mode it starts a2 (or
+ * bench/alarm_baseline) on the virtual clock, creates -t alarm
+ * threads for each of -T message types, submits -n alarms spread over
+ * the types with delays of 1 to 5 seconds, and waits until every alarm
+ * has been printed.
+ *
+ *   poll      every alarm thread scans alarm_list and keeps its own
+ *             timer queue (the default)
+ *   dispatch  one dispatch thread owns all deadlines and posts due
+ *             alarms to idle workers (a2 -m dispatch)
+ *   thread    a thread for every alarm (alarm_baseline -e thread)
+ *   cond      one alarm thread on a sorted list and a condition
+ *             variable (alarm_baseline -e cond)
+ *
+ * The baselines ignore the Create_Thread commands and fire every alarm
+ * whatever its type, so their rows are the floor the type threads are
+ * judged against.
+ *
+ * It reports how long submitting the alarms took, how long after the
+ * last submission the last alarm was printed, and the CPU time a2
+ * used, which is where the polling threads show up. With -O seconds,
+ * each mode is run again with a2 -O, to show what writing the fired
+ * alarms in deadline order costs.
+ *
+ * Usage: dispatch_bench [-T types] [-t threads] [-n alarms] [-v scale] [-a a2] [-m mode]
+ *        [-O seconds] [-b alarm_baseline]
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "errors.h"
+
+static const char *modes[] = { "poll", "dispatch", "thread", "cond" };
+
+#define A2_MODES    2   /* the rest are baselines */
+
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static long printed;
+static double last_printed;
+
+static double now_s (void)
+{
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Count the alarms a2 prints, noting when the latest one came out.
+ */
+static void *reader (void *arg)
+{
+	FILE *out = (FILE *)arg;
+	char line[512];
+	int status;
+
+	while (fgets (line, sizeof (line), out) != NULL) {
+		if (strstr (line, "Printed by") == NULL)
+			continue;
+		status = pthread_mutex_lock (&done_mutex);
+		if (status != 0)
+			err_abort (status, "Lock done mutex");
+		printed++;
+		last_printed = now_s ();
+		status = pthread_cond_signal (&done_cond);
+		if (status != 0)
+			err_abort (status, "Signal done");
+		status = pthread_mutex_unlock (&done_mutex);
+		if (status != 0)
+			err_abort (status, "Unlock done mutex");
+	}
+	fclose (out);
+	return NULL;
+}
+
+static void bench_mode (const char *mode, const char *a2, const char *baseline, int types,
+	int threads, long alarms, const char *scale, const char *order)
+{
+	char label[32];
+	int in[2], out[2], status, t, k;
+	pid_t pid;
+	pthread_t reader_id;
+	FILE *feed;
+	struct rusage usage;
+	struct timespec limit;
+	double start, submitted;
+	long i;
+
+	if (pipe (in) != 0 || pipe (out) != 0)
+		errno_abort ("Pipe");
+	pid = fork ();
+	if (pid < 0)
+		errno_abort ("Fork");
+	if (pid == 0) {
+		dup2 (in[0], 0);
+		dup2 (out[1], 1);
+		close (in[0]);
+		close (in[1]);
+		close (out[0]);
+		close (out[1]);
+		if (baseline != NULL)
+			execl (baseline, baseline, "-v", scale, "-e", mode, (char *)NULL);
+		else if (order != NULL)
+			execl (a2, a2, "-v", scale, "-m", mode, "-O", order, (char *)NULL);
+		else
+			execl (a2, a2, "-v", scale, "-m", mode, (char *)NULL);
+		errno_abort (baseline != NULL ? "Exec alarm_baseline" : "Exec a2");
+	}
+	close (in[0]);
+	close (out[1]);
+	feed = fdopen (in[1], "w");
+	if (feed == NULL)
+		errno_abort ("Open feed");
+	printed = 0;
+	status = pthread_create (&reader_id, NULL, reader, fdopen (out[0], "r"));
+	if (status != 0)
+		err_abort (status, "Create reader");
+
+	for (t = 1; t <= types; t++)
+		for (k = 0; k < threads; k++)
+			fprintf (feed, "Create_Thread: MessageType(%d)\n", t);
+	fflush (feed);
+	start = now_s ();
+	for (i = 0; i < alarms; i++)
+		fprintf (feed, "%ld MessageType(%ld) bench alarm %ld\n", 1 + i % 5, 1 + i % types, i);
+	fflush (feed);
+	submitted = now_s ();
+
+	status = pthread_mutex_lock (&done_mutex);
+	if (status != 0)
+		err_abort (status, "Lock done mutex");
+	clock_gettime (CLOCK_REALTIME, &limit);
+	limit.tv_sec += 120;
+	while (printed < alarms && status != ETIMEDOUT)
+		status = pthread_cond_timedwait (&done_cond, &done_mutex, &limit);
+	pthread_mutex_unlock (&done_mutex);
+	if (printed < alarms) {
+		fprintf (stderr, "%s: only %ld of %ld alarms printed\n", mode, printed, alarms);
+		kill (pid, SIGKILL);
+		exit (1);
+	}
+
+	fclose (feed);
+	if (wait4 (pid, &status, 0, &usage) < 0)
+		errno_abort (baseline != NULL ? "Wait for alarm_baseline" : "Wait for a2");
+	pthread_join (reader_id, NULL);
+	snprintf (label, sizeof (label), "%s%s", mode, order != NULL ? " -O" : "");
+	printf ("%-12s %8d %8ld %12.1f %12.1f %10.2f\n", label, types * threads, alarms,
+		(submitted - start) * 1e3, (last_printed - submitted) * 1e3,
+		usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6);
+}
+
+int main (int argc, char *argv[])
+{
+	int types = 100, threads = 4, option, i;
+	long alarms = 2000;
+	const char *a2 = "./a2", *baseline = "./bench/alarm_baseline", *scale = "20";
+	const char *only = NULL, *order = NULL;
+
+	while ((option = getopt (argc, argv, "T:t:n:v:a:m:O:b:")) != -1) {
+		switch (option) {
+		case 'T':
+			types = atoi (optarg);
+			break;
+		case 't':
+			threads = atoi (optarg);
+			break;
+		case 'n':
+			alarms = atol (optarg);
+			break;
+		case 'v':
+			scale = optarg;
+			break;
+		case 'a':
+			a2 = optarg;
+			break;
+		case 'm':
+			only = optarg;
+			break;
+		case 'O':
+			order = optarg;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-T types] [-t threads] [-n alarms] [-v scale] [-a a2] [-m mode]\n"
+				"       [-O seconds] [-b alarm_baseline]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (types < 1 || threads < 1 || alarms < 1) {
+		fprintf (stderr, "-T, -t and -n must be positive\n");
+		exit (1);
+	}
+
+	printf ("dispatch benchmark: %d types x %d threads, %ld alarms, clock x%s\n",
+		types, threads, alarms, scale);
+	printf ("%-12s %8s %8s %12s %12s %10s\n", "mode", "threads", "alarms",
+		"submit ms", "drain ms", "cpu s");
+	fflush (stdout);
+	for (i = 0; i < 4; i++) {
+		if (only != NULL && strcmp (only, modes[i]) != 0)
+			continue;
+		bench_mode (modes[i], a2, i < A2_MODES ? NULL : baseline, types, threads, alarms,
+			scale, NULL);
+		fflush (stdout);
+		if (order != NULL && i < A2_MODES) {
+			bench_mode (modes[i], a2, NULL, types, threads, alarms, scale, order);
+			fflush (stdout);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * edf_bench.c
+ * Compares how late alarms of a mixed-type workload come out under
+ * per-type FIFO workers and under earliest-deadline-first on shared
+ * workers. For each policy it starts a2 on the virtual clock with -w
+ * workers, submits -n alarms of -T message types with delays of 1 to
+ * -d seconds, type 1 taking -H percent of them, and reads a2's output
+ * slowly enough (-c microseconds an alarm) that alarms fall due faster
+ * than they can be printed.
+ *
+ *   fifo  a2 -m dispatch, the workers split between the types, each
+ *         serving its own type's alarms in deadline order
+ *   edf   a2 -m edf, every worker serving every type, always given the
+ *         earliest due alarm
+ *
+ * Each alarm's text says when it was submitted, so the reader can tell
+ * how late it is when it arrives, in seconds of alarm time. It reports
+ * the median, 99th percentile and worst lateness for each type and for
+ * all alarms. Under FIFO the busy type falls behind on its own; under
+ * EDF the backlog is shared out in deadline order.
+ *
+ * Usage: edf_bench [-T types] [-w workers] [-n alarms] [-d delay] [-H percent]
+ *                  [-c microseconds] [-v scale] [-a a2] [-m policy]
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "errors.h"
+
+static const char *policies[] = { "fifo", "edf" };
+
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static long printed, submitted_alarms;
+static double *late;            /* by alarm number, in alarm seconds */
+static int *late_type;
+static double scale;
+static long consume_us;
+
+static double now_s (void)
+{
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int by_value (const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Note how late each alarm's message arrives, taking -c microseconds
+ * over every alarm like a slow consumer would.
+ */
+static void *reader (void *arg)
+{
+	FILE *out = (FILE *)arg;
+	struct timespec pause;
+	char line[512], *text;
+	double submitted, lateness;
+	long alarm;
+	int seconds, type, status;
+
+	pause.tv_sec = consume_us / 1000000;
+	pause.tv_nsec = consume_us % 1000000 * 1000;
+	while (fgets (line, sizeof (line), out) != NULL) {
+		/*
+		 *Step over any "Alarm> " prompts a2 wrote ahead of the line
+		 */
+		for (text = line; strncmp (text, "Alarm> ", 7) == 0; text += 7)
+			;
+		if (sscanf (text, "(%d) edf %ld type %d at %lf", &seconds, &alarm, &type, &submitted) != 4
+				|| alarm < 0 || alarm >= submitted_alarms)
+			continue;
+		lateness = (now_s () - submitted) * scale - seconds;
+		late[alarm] = lateness > 0 ? lateness : 0;
+		late_type[alarm] = type;
+		if (consume_us > 0)
+			nanosleep (&pause, NULL);
+		status = pthread_mutex_lock (&done_mutex);
+		if (status != 0)
+			err_abort (status, "Lock done mutex");
+		printed++;
+		status = pthread_cond_signal (&done_cond);
+		if (status != 0)
+			err_abort (status, "Signal done");
+		status = pthread_mutex_unlock (&done_mutex);
+		if (status != 0)
+			err_abort (status, "Unlock done mutex");
+	}
+	fclose (out);
+	return NULL;
+}
+
+/*
+ * Print the lateness of the alarms of one type, or of all with type 0.
+ */
+static void report (const char *policy, int type, long alarms)
+{
+	double *values;
+	char label[16];
+	long i, n = 0;
+
+	values = malloc (alarms * sizeof (double));
+	if (values == NULL)
+		errno_abort ("Allocate lateness");
+	for (i = 0; i < alarms; i++)
+		if (type == 0 || late_type[i] == type)
+			values[n++] = late[i];
+	if (type == 0)
+		snprintf (label, sizeof (label), "all");
+	else
+		snprintf (label, sizeof (label), "%d", type);
+	if (n > 0) {
+		qsort (values, n, sizeof (double), by_value);
+		printf ("%-6s %6s %8ld %10.2f %10.2f %10.2f\n", policy, label, n,
+			values[n / 2], values[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1], values[n - 1]);
+	}
+	free (values);
+}
+
+static void bench_policy (const char *policy, const char *a2, int types, int workers,
+	long alarms, int delay, int hot, const char *clock)
+{
+	int in[2], out[2], status, t, k, type;
+	pid_t pid;
+	pthread_t reader_id;
+	FILE *feed;
+	struct timespec limit;
+	long i;
+
+	if (pipe (in) != 0 || pipe (out) != 0)
+		errno_abort ("Pipe");
+	/*
+	 *Keep the pipe small so a2 feels the slow reader at once rather
+	 *than after a pipe's worth of lines
+	 */
+	fcntl (out[0], F_SETPIPE_SZ, 4096);
+	pid = fork ();
+	if (pid < 0)
+		errno_abort ("Fork");
+	if (pid == 0) {
+		dup2 (in[0], 0);
+		dup2 (out[1], 1);
+		close (in[0]);
+		close (in[1]);
+		close (out[0]);
+		close (out[1]);
+		execl (a2, a2, "-v", clock, "-m", strcmp (policy, "edf") == 0 ? "edf" : "dispatch",
+			(char *)NULL);
+		errno_abort ("Exec a2");
+	}
+	close (in[0]);
+	close (out[1]);
+	feed = fdopen (in[1], "w");
+	if (feed == NULL)
+		errno_abort ("Open feed");
+	printed = 0;
+	submitted_alarms = alarms;
+	memset (late, 0, alarms * sizeof (double));
+	memset (late_type, 0, alarms * sizeof (int));
+	status = pthread_create (&reader_id, NULL, reader, fdopen (out[0], "r"));
+	if (status != 0)
+		err_abort (status, "Create reader");
+
+	if (strcmp (policy, "edf") == 0) {
+		for (k = 0; k < workers; k++)
+			fprintf (feed, "Create_Thread: MessageType(1-%d)\n", types);
+	} else {
+		for (k = 0; k < workers; k++)
+			fprintf (feed, "Create_Thread: MessageType(%d)\n", 1 + k % types);
+	}
+	fflush (feed);
+	for (i = 0; i < alarms; i++) {
+		if ((int)(i % 100) < hot || types == 1)
+			type = 1;
+		else
+			type = 2 + (int)(i % (types - 1));
+		fprintf (feed, "%ld MessageType(%d) edf %ld type %d at %.6f\n",
+			1 + i % delay, type, i, type, now_s ());
+	}
+	fflush (feed);
+
+	status = pthread_mutex_lock (&done_mutex);
+	if (status != 0)
+		err_abort (status, "Lock done mutex");
+	clock_gettime (CLOCK_REALTIME, &limit);
+	limit.tv_sec += 120;
+	while (printed < alarms && status != ETIMEDOUT)
+		status = pthread_cond_timedwait (&done_cond, &done_mutex, &limit);
+	pthread_mutex_unlock (&done_mutex);
+	if (printed < alarms) {
+		fprintf (stderr, "%s: only %ld of %ld alarms printed\n", policy, printed, alarms);
+		kill (pid, SIGKILL);
+		exit (1);
+	}
+
+	fclose (feed);
+	if (waitpid (pid, &status, 0) < 0)
+		errno_abort ("Wait for a2");
+	pthread_join (reader_id, NULL);
+	for (t = 1; t <= types; t++)
+		report (policy, t, alarms);
+	report (policy, 0, alarms);
+}
+
+int main (int argc, char *argv[])
+{
+	int types = 4, workers = 4, delay = 5, hot = 70, option, i;
+	long alarms = 2000;
+	const char *a2 = "./a2", *clock = "100", *only = NULL;
+
+	consume_us = 200;
+	while ((option = getopt (argc, argv, "T:w:n:d:H:c:v:a:m:")) != -1) {
+		switch (option) {
+		case 'T':
+			types = atoi (optarg);
+			break;
+		case 'w':
+			workers = atoi (optarg);
+			break;
+		case 'n':
+			alarms = atol (optarg);
+			break;
+		case 'd':
+			delay = atoi (optarg);
+			break;
+		case 'H':
+			hot = atoi (optarg);
+			break;
+		case 'c':
+			consume_us = atol (optarg);
+			break;
+		case 'v':
+			clock = optarg;
+			break;
+		case 'a':
+			a2 = optarg;
+			break;
+		case 'm':
+			only = optarg;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-T types] [-w workers] [-n alarms] [-d delay] [-H percent]"
+				" [-c microseconds] [-v scale] [-a a2] [-m policy]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (types < 1 || workers < types || alarms < 1 || delay < 1
+			|| hot < 0 || hot > 100 || consume_us < 0) {
+		fprintf (stderr, "-T, -n and -d must be positive, -w at least -T, -H a percentage\n");
+		exit (1);
+	}
+	scale = atof (clock);
+	if (scale <= 0) {
+		fprintf (stderr, "-v must be positive\n");
+		exit (1);
+	}
+	late = malloc (alarms * sizeof (double));
+	late_type = malloc (alarms * sizeof (int));
+	if (late == NULL || late_type == NULL)
+		errno_abort ("Allocate lateness");
+
+	printf ("edf benchmark: %d types (type 1 %d%%), %d workers, %ld alarms over %d s,"
+		" %ld us an alarm to read, clock x%s\n",
+		types, hot, workers, alarms, delay, consume_us, clock);
+	printf ("lateness in seconds of alarm time\n");
+	printf ("%-6s %6s %8s %10s %10s %10s\n", "policy", "type", "alarms", "p50", "p99", "max");
+	fflush (stdout);
+	for (i = 0; i < 2; i++) {
+		if (only != NULL && strcmp (only, policies[i]) != 0)
+			continue;
+		bench_policy (policies[i], a2, types, workers, alarms, delay, hot, clock);
+		fflush (stdout);
+	}
+	return 0;
+}
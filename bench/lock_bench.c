@@ -0,0 +1,202 @@
+/*
+ * lock_bench.c
+ * Contention benchmark for the scheduler lock kinds a2 -l offers.
+ * -t threads loop taking the lock, doing -c units of work inside it
+ * and -w units outside it, for -d milliseconds per lock kind. This
+ * is the shape of a2 under load: main inserting alarms while the
+ * alarm threads poll alarm_list.
+ *
+ * For each kind it reports throughput, the fewest and most
+ * acquisitions any one thread got (how fair the handoff was), and the
+ * 99th percentile (rounded up to a power of two) and worst time a
+ * thread waited for the lock. A
+ * counter updated only inside the lock is checked at the end, so a
+ * lock that fails to exclude fails the run instead of looking fast.
+ *
+ * Usage: lock_bench [-t threads] [-d ms] [-c work] [-w work] [-l kind]
+ */
+#include <time.h>
+#include "errors.h"
+#include "sched_lock.h"
+
+#define LATENCY_BUCKETS 64
+
+typedef struct bench_thread_tag {
+	pthread_t           thread_id;
+	long                ops;
+	long long           max_ns;
+	long                latency[LATENCY_BUCKETS];   /* log2 ns histogram */
+} bench_thread_t;
+
+static sched_lock_t lock = SCHED_LOCK_INITIALIZER;
+static volatile int running;
+static int start_line;
+static long shared_count;
+static long critical_work = 20, outside_work = 200;
+
+static long long now_ns (void)
+{
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void work (long units)
+{
+	volatile long sink = 0;
+	long i;
+
+	for (i = 0; i < units; i++)
+		sink += i;
+}
+
+static int log2_bucket (long long ns)
+{
+	int bucket = 0;
+
+	while (ns > 1 && bucket < LATENCY_BUCKETS - 1) {
+		ns >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+static void *bench_thread (void *arg)
+{
+	bench_thread_t *self = (bench_thread_t *)arg;
+	long long start, waited;
+	int status;
+
+	while (!__atomic_load_n (&start_line, __ATOMIC_ACQUIRE))
+		;
+	while (running) {
+		start = now_ns ();
+		status = sched_lock_lock (&lock);
+		if (status != 0)
+			err_abort (status, "Lock");
+		waited = now_ns () - start;
+		shared_count++;
+		work (critical_work);
+		status = sched_lock_unlock (&lock);
+		if (status != 0)
+			err_abort (status, "Unlock");
+		self->ops++;
+		self->latency[log2_bucket (waited)]++;
+		if (waited > self->max_ns)
+			self->max_ns = waited;
+		work (outside_work);
+	}
+	return NULL;
+}
+
+static void bench_kind (sched_lock_kind_t kind, bench_thread_t *threads, int nthreads, long ms)
+{
+	struct timespec duration;
+	long latency[LATENCY_BUCKETS] = { 0 };
+	long total = 0, min_ops = -1, max_ops = 0, seen = 0;
+	long long max_ns = 0;
+	long long start, elapsed;
+	int i, bucket, status;
+
+	memset (threads, 0, nthreads * sizeof (*threads));
+	lock.kind = kind;
+	shared_count = 0;
+	running = 1;
+	start_line = 0;
+	for (i = 0; i < nthreads; i++) {
+		status = pthread_create (&threads[i].thread_id, NULL, bench_thread, &threads[i]);
+		if (status != 0)
+			err_abort (status, "Create thread");
+	}
+	start = now_ns ();
+	__atomic_store_n (&start_line, 1, __ATOMIC_RELEASE);
+	duration.tv_sec = ms / 1000;
+	duration.tv_nsec = (ms % 1000) * 1000000;
+	nanosleep (&duration, NULL);
+	running = 0;
+	for (i = 0; i < nthreads; i++) {
+		status = pthread_join (threads[i].thread_id, NULL);
+		if (status != 0)
+			err_abort (status, "Join thread");
+	}
+	elapsed = now_ns () - start;
+
+	for (i = 0; i < nthreads; i++) {
+		total += threads[i].ops;
+		if (min_ops < 0 || threads[i].ops < min_ops)
+			min_ops = threads[i].ops;
+		if (threads[i].ops > max_ops)
+			max_ops = threads[i].ops;
+		if (threads[i].max_ns > max_ns)
+			max_ns = threads[i].max_ns;
+		for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++)
+			latency[bucket] += threads[i].latency[bucket];
+	}
+	if (shared_count != total) {
+		fprintf (stderr, "%s: lock did not exclude (%ld != %ld)\n",
+			sched_lock_kind_name (kind), shared_count, total);
+		exit (1);
+	}
+	for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		seen += latency[bucket];
+		if (seen * 100 >= total * 99)
+			break;
+	}
+	printf ("%-8s %12.0f %10ld %10ld %12lld %12lld\n", sched_lock_kind_name (kind),
+		total * 1e9 / elapsed, min_ops, max_ops, 1LL << (bucket + 1), max_ns);
+}
+
+int main (int argc, char *argv[])
+{
+	bench_thread_t *threads;
+	long ms = 200;
+	int nthreads = 4, option, kind, only = -1;
+	sched_lock_kind_t parsed;
+
+	while ((option = getopt (argc, argv, "t:d:c:w:l:")) != -1) {
+		switch (option) {
+		case 't':
+			nthreads = atoi (optarg);
+			break;
+		case 'd':
+			ms = atol (optarg);
+			break;
+		case 'c':
+			critical_work = atol (optarg);
+			break;
+		case 'w':
+			outside_work = atol (optarg);
+			break;
+		case 'l':
+			if (sched_lock_kind_parse (optarg, &parsed) != 0) {
+				fprintf (stderr, "Unknown lock \"%s\"\n", optarg);
+				exit (1);
+			}
+			only = parsed;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-t threads] [-d ms] [-c work] [-w work] [-l kind]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (nthreads < 1 || ms < 1) {
+		fprintf (stderr, "-t and -d must be positive\n");
+		exit (1);
+	}
+	threads = calloc (nthreads, sizeof (*threads));
+	if (threads == NULL)
+		errno_abort ("Allocate threads");
+
+	printf ("lock benchmark: %d threads, %ld ms, work %ld inside / %ld outside\n",
+		nthreads, ms, critical_work, outside_work);
+	printf ("%-8s %12s %10s %10s %12s %12s\n", "lock", "ops/s", "min ops", "max ops",
+		"p99 wait ns", "max wait ns");
+	for (kind = 0; kind < SCHED_LOCK_NKINDS; kind++) {
+		if (only >= 0 && kind != only)
+			continue;
+		bench_kind ((sched_lock_kind_t)kind, threads, nthreads, ms);
+	}
+	free (threads);
+	return 0;
+}
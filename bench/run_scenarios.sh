@@ -0,0 +1,251 @@
+#!/bin/sh
+#
+# run_scenarios.sh
+# Replays the scenario scripts in bench/scenarios through a2, checks
+# the normalised output against the scenario's golden file and records
+# the end-to-end runtime and the time spent in each phase. Results are
+# printed and appended to bench_output.txt.
+#
+# Usage: bench/run_scenarios.sh [-r] [-u] [-t] [-s scale] [-q backend] [-l lock] [-m mode] [-x args] [-a a2] [scenario ...]
+#   -r          run on the real clock instead of the virtual clock
+#   -u          rewrite the golden files from this run instead of diffing
+#   -t          also capture the commands with a2 -T and check that
+#               a2replay gives back exactly what was fed
+#   -s scale    virtual clock speed-up passed to a2 -v (default 20)
+#   -q backend  timer queue backend passed to a2 -q
+#   -l lock     scheduler lock kind passed to a2 -l
+#   -m mode     alarm thread mode passed to a2 -m
+#   -x args     further a2 arguments
+#   -a path     binary to run (default ./a2)
+#
+# A scenario is a list of a2 commands, one per line, plus directives:
+#   @args ARGS      extra a2 arguments for this scenario
+#   @include FILE   feed the commands in FILE (relative to the top of the tree)
+#   @phase NAME     start a new timed phase
+#   @sleep S        wait S scenario seconds (S / scale under the virtual clock)
+#   @pace S         wait S scenario seconds after each following command
+#   # ...           comment
+#
+# Normalisation removes the "Alarm> " prompts, replaces timestamps
+# with <t>, barrier times with <s> and thread IDs with M (main) and T1, T2, ... in order of
+# first appearance; a thread ID reused by a newly created thread gets
+# a new name. Lines are then grouped by the thread that printed
+# them, keeping each thread's own order, since the interleaving between
+# threads is up to the scheduler.
+#
+# Under -m edf a worker is only chosen when an alarm is due, so it
+# announces the assignment just before printing the alarm rather than
+# when the alarm arrives. The "Assigned to" lines are left out of both
+# sides of the comparison in that mode.
+#
+cd "$(dirname "$0")/.." || exit 1
+
+real=0
+update=0
+scale=20
+backend=
+lock=
+mode=
+more=
+a2=./a2
+trace=0
+while getopts "ruts:q:l:m:x:a:" option; do
+	case $option in
+	r) real=1 ;;
+	u) update=1 ;;
+	t) trace=1 ;;
+	s) scale=$OPTARG ;;
+	q) backend=$OPTARG ;;
+	l) lock=$OPTARG ;;
+	m) mode=$OPTARG ;;
+	x) more=$OPTARG ;;
+	a) a2=$OPTARG ;;
+	*) echo "Usage: $0 [-r] [-u] [-t] [-s scale] [-q backend] [-l lock] [-m mode] [-x args] [-a a2] [scenario ...]" >&2
+	   exit 2 ;;
+	esac
+done
+shift $((OPTIND - 1))
+if [ $# -eq 0 ]; then
+	set -- bench/scenarios/*.scn
+fi
+
+args=
+[ -n "$backend" ] && args="-q $backend"
+[ -n "$lock" ] && args="$args -l $lock"
+[ -n "$mode" ] && args="$args -m $mode"
+[ -n "$more" ] && args="$args $more"
+if [ $real -eq 1 ]; then
+	clock=real
+else
+	clock="virtual x$scale"
+	args="$args -v $scale"
+fi
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT INT TERM
+
+now_ns () {
+	date +%s%N
+}
+
+#
+# Convert scenario seconds to the real seconds to sleep for.
+#
+real_seconds () {
+	if [ $real -eq 1 ]; then
+		echo "$1"
+	else
+		echo "$1 $scale" | awk '{ print $1 / $2 }'
+	fi
+}
+
+#
+# Write the commands of a scenario to stdout, carrying out its
+# directives, and log phase boundaries to $tmp/phases.
+#
+pace=0
+feed () {
+	while IFS= read -r line || [ -n "$line" ]; do
+		case $line in
+		"#"*|""|"@args "*)
+			;;
+		"@include "*)
+			feed < "${line#@include }"
+			;;
+		"@phase "*)
+			echo "${line#@phase } $(now_ns)" >> "$tmp/phases"
+			;;
+		"@sleep "*)
+			sleep "$(real_seconds "${line#@sleep }")"
+			;;
+		"@pace "*)
+			pace=$(real_seconds "${line#@pace }")
+			;;
+		*)
+			printf '%s\n' "$line"
+			[ "$pace" != 0 ] && sleep "$pace"
+			;;
+		esac
+	done
+}
+
+normalise () {
+	awk '
+	function id(raw, prefix) {
+		if (!(raw in ids)) {
+			if (prefix == "M")
+				ids[raw] = "M"
+			else
+				ids[raw] = "T" (++threads)
+		}
+		return ids[raw]
+	}
+	function rename(pattern, prefix,    head, num) {
+		if (match($0, pattern)) {
+			head = substr($0, RSTART, RLENGTH)
+			match(head, /[0-9]+$/)
+			num = substr(head, RSTART, RLENGTH)
+			sub(pattern, substr(head, 1, length(head) - length(num)) id(num, prefix))
+		}
+	}
+	{
+		gsub(/Alarm> /, "")
+		if ($0 == "")
+			next
+		gsub(/ at -?[0-9]+:/, " at <t>:")
+		sub(/ in [0-9.]+ Seconds$/, " in <s> Seconds")
+		if (match($0, /^New Alarm Thread [0-9]+/))
+			delete ids[substr($0, 18, RLENGTH - 17)]
+		rename("Main Thread [0-9]+", "M")
+		rename("Alarm Thread [0-9]+", "T")
+		stream = "main"
+		if (match($0, /(Assigned to|Printed by) Alarm Thread T[0-9]+/)) {
+			stream = substr($0, RSTART, RLENGTH)
+			sub(/.* /, "", stream)
+		} else if (held == "" && $0 ~ /^\(-?[0-9]+\) /) {
+			held = $0
+			next
+		}
+		if (held != "") {
+			out[stream] = out[stream] held "\n"
+			held = ""
+		}
+		out[stream] = out[stream] $0 "\n"
+	}
+	END {
+		if (held != "")
+			out["main"] = out["main"] held "\n"
+		printf "%s", out["main"]
+		for (i = 1; i <= threads; i++)
+			printf "--- T%d\n%s", i, out["T" i]
+	}'
+}
+
+failed=0
+for scenario in "$@"; do
+	name=$(basename "$scenario" .scn)
+	golden=bench/scenarios/$name.golden
+	extra=$(sed -n 's/^@args //p' "$scenario" | tr '\n' ' ')
+	rm -f "$tmp/phases"
+	traced=
+	start=$(now_ns)
+	if [ $trace -eq 1 ]; then
+		feed < "$scenario" | tee "$tmp/fed" | $a2 $args $extra -T "$tmp/trace" > "$tmp/stdout" 2> "$tmp/stderr"
+	else
+		feed < "$scenario" | $a2 $args $extra > "$tmp/stdout" 2> "$tmp/stderr"
+	fi
+	end=$(now_ns)
+	{
+		normalise < "$tmp/stdout"
+		if [ -s "$tmp/stderr" ]; then
+			echo "--- stderr"
+			cat "$tmp/stderr"
+		fi
+	} > "$tmp/actual"
+
+	if [ $update -eq 1 ]; then
+		cp "$tmp/actual" "$golden"
+		result=updated
+	elif [ ! -f "$golden" ]; then
+		result="FAIL (no $golden)"
+		failed=1
+	elif [ "$mode" = edf ]; then
+		grep -v "Assigned to Alarm Thread" "$golden" > "$tmp/golden"
+		grep -v "Assigned to Alarm Thread" "$tmp/actual" > "$tmp/filtered"
+		if diff -u "$tmp/golden" "$tmp/filtered" > "$tmp/diff"; then
+			result=ok
+		else
+			result=FAIL
+			failed=1
+			cat "$tmp/diff"
+		fi
+	elif diff -u "$golden" "$tmp/actual" > "$tmp/diff"; then
+		result=ok
+	else
+		result=FAIL
+		failed=1
+		cat "$tmp/diff"
+	fi
+	if [ $trace -eq 1 ] && [ $update -eq 0 ]; then
+		if ./a2replay -f "$tmp/trace" > "$tmp/replayed" 2>&1 \
+				&& diff -u "$tmp/fed" "$tmp/replayed" > "$tmp/diff"; then
+			traced=$(./a2replay -l "$tmp/trace" | awk 'END { printf " traced=%.1fms", $1 * 1e3 }')
+		else
+			result="FAIL (replay)"
+			failed=1
+			cat "$tmp/replayed" "$tmp/diff"
+		fi
+	fi
+
+	phases=
+	if [ -f "$tmp/phases" ]; then
+		phases=$(echo "end $end" | cat "$tmp/phases" - | awk '
+			NR > 1 { printf " %s=%.1fms", name, ($2 - t) / 1e6 }
+			{ name = $1; t = $2 }')
+	fi
+	line=$(printf '%-12s %-8s %-7s %-9s %-12s %-8s %8.1fms%s%s' "$name" "${backend:-list}" "${lock:-mutex}" "${mode:-poll}" \
+		"$clock" "$result" "$(echo "$start $end" | awk '{ print ($2 - $1) / 1e6 }')" "$phases" "$traced")
+	echo "$line"
+	echo "$(date '+%Y-%m-%d %H:%M:%S') $line" >> bench_output.txt
+done
+exit $failed
@@ -0,0 +1,358 @@
+/*
+ * scan_bench.c
+ * Throughput of the command scanner in cmd_scan.c, and a check that
+ * it agrees with get_cmd_type.
+ *
+ * A buffer of -n generated command lines, mostly alarm requests with
+ * some Create_Thread, Terminate_Thread, Reschedule_Alarm and Stats
+ * lines, is split into lines and parsed with each kernel set the CPU
+ * supports. The reference is what a2 did before: memchr to split and
+ * get_cmd_type to parse. Rates are in GB/s of input, best of -r runs.
+ *
+ * The check first splits random buffers at every offset with each
+ * kernel set and compares against the scalar one, then runs -c lines,
+ * valid commands with random damage (bytes changed, inserted and
+ * removed, odd whitespace, long numbers), through cmd_scan_parse and
+ * get_cmd_type and compares every output, taking every other
+ * message from the span cmd_scan_parse points at instead. Any difference fails the
+ * run. Lines whose first two fields would overflow get_cmd_type's
+ * own buffers are left out.
+ *
+ * Usage: scan_bench [-n lines] [-c check lines] [-r runs] [-s seed]
+ */
+#include <ctype.h>
+#include <fcntl.h>
+#include <time.h>
+#include "errors.h"
+#include "cmd_scan.h"
+#include "command.h"
+
+#define LINE_SIZE       256
+
+static const char *impls[] = {"scalar", "sse2", "avx2"};
+
+#define NIMPLS      ((int)(sizeof (impls) / sizeof (impls[0])))
+
+typedef struct parse_result_tag {
+	int                 ret;
+	unsigned int        msg_type;
+	unsigned int        alarm_second;
+	unsigned long       alarm_id;
+	char                message[CMD_MESSAGE_MAX + 1];
+} parse_result_t;
+
+static double elapsed_ns (struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static void random_word (char *out, int len)
+{
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	int i;
+
+	for (i = 0; i < len; i++)
+		out[i] = chars[rand () % (sizeof (chars) - 1)];
+	out[len] = '\0';
+}
+
+/*
+ * One command in the mix a busy a2 sees, without its newline.
+ */
+static int random_command (char *out)
+{
+	char word[64];
+	int r = rand () % 100;
+
+	random_word (word, 4 + rand () % 40);
+	if (r < 80)
+		return sprintf (out, "%d MessageType(%d) %s %d", rand () % 300, 1 + rand () % 1000,
+			word, rand () % 10000);
+	if (r < 90)
+		return sprintf (out, "Create_Thread: MessageType(%d)", 1 + rand () % 1000);
+	if (r < 95)
+		return sprintf (out, "Terminate_Thread: MessageType(%d)", 1 + rand () % 1000);
+	if (r < 98)
+		return sprintf (out, "Reschedule_Alarm: %d %d", rand () % 100000, rand () % 300);
+	return sprintf (out, "Stats:");
+}
+
+/*
+ * A command damaged in a few random ways, without its newline.
+ */
+static int damaged_command (char *out)
+{
+	static const char odd[] = " \t\r\v\f0123456789-+()xM:";
+	char *p;
+	int len = random_command (out), edits = rand () % 4, pos, n;
+
+	if (rand () % 8 == 0) {
+		n = 1 + rand () % 14;
+		memmove (out + n, out, len + 1);
+		memset (out, '9', n);
+		len += n;
+	}
+	while (edits-- > 0 && len > 0) {
+		pos = rand () % len;
+		switch (rand () % 4) {
+		case 0:
+			out[pos] = odd[rand () % (sizeof (odd) - 1)];
+			break;
+		case 1:
+			if (len < LINE_SIZE - 40) {
+				memmove (out + pos + 1, out + pos, len - pos + 1);
+				out[pos] = odd[rand () % (sizeof (odd) - 1)];
+				len++;
+			}
+			break;
+		case 2:
+			memmove (out + pos, out + pos + 1, len - pos);
+			len--;
+			break;
+		default:
+			if (len < LINE_SIZE - 40) {
+				n = 1 + rand () % 30;
+				p = out + pos;
+				memmove (p + n, p, len - pos + 1);
+				memset (p, rand () % 2 ? ' ' : 'w', n);
+				len += n;
+			}
+		}
+	}
+	if (rand () % 4 == 0 && len < LINE_SIZE - 170) {
+		random_word (out + len, 150);
+		len += 150;
+	}
+	return len;
+}
+
+/*
+ * Whether get_cmd_type can take line without overflowing the
+ * char[20] buffers it reads the first two fields into.
+ */
+static int fields_fit (const char *line)
+{
+	int field, n;
+
+	for (field = 0; field < 2; field++) {
+		while (isspace ((unsigned char)*line))
+			line++;
+		for (n = 0; *line != '\0' && !isspace ((unsigned char)*line); n++)
+			line++;
+		if (n >= 20)
+			return 0;
+	}
+	return 1;
+}
+
+static void reset (parse_result_t *r)
+{
+	memset (r, 0x5a, sizeof (*r));
+	strcpy (r->message, "unset");
+}
+
+static int same (parse_result_t *a, parse_result_t *b)
+{
+	return a->ret == b->ret && a->msg_type == b->msg_type
+		&& a->alarm_second == b->alarm_second && a->alarm_id == b->alarm_id
+		&& strcmp (a->message, b->message) == 0;
+}
+
+static long check_split (unsigned int seed)
+{
+	char buf[512];
+	long off, len, want, failures = 0;
+	int i, impl;
+
+	srand (seed);
+	for (i = 0; i < (int)sizeof (buf); i++)
+		buf[i] = rand () % 40 == 0 ? '\n' : 'a' + rand () % 26;
+	for (impl = 0; impl < NIMPLS; impl++) {
+		if (cmd_scan_use (impls[impl]) != 0)
+			continue;
+		for (off = 0; off < 64; off++) {
+			for (len = 0; off + len <= (long)sizeof (buf); len++) {
+				for (want = 0; want < len && buf[off + want] != '\n'; want++)
+					;
+				if (cmd_scan_line (buf + off, len) != want) {
+					if (failures++ < 10)
+						printf ("split mismatch (%s): offset %ld length %ld\n", impls[impl], off, len);
+				}
+			}
+		}
+	}
+	return failures;
+}
+
+static long check_parse (long cases, unsigned int seed, long *fast)
+{
+	char line[LINE_SIZE], copy[LINE_SIZE];
+	parse_result_t want, got;
+	cmd_text_t text;
+	long i, len, failures = 0;
+	int impl;
+
+	for (impl = 0; impl < NIMPLS; impl++) {
+		if (cmd_scan_use (impls[impl]) != 0)
+			continue;
+		srand (seed);
+		for (i = 0; i < cases; i++) {
+			len = damaged_command (line);
+			line[len++] = '\n';
+			line[len] = '\0';
+			if (!fields_fit (line))
+				continue;
+			reset (&want);
+			strcpy (copy, line);
+			want.ret = get_cmd_type (copy, &want.msg_type, &want.alarm_second,
+				want.message, &want.alarm_id);
+			reset (&got);
+			strcpy (copy, line);
+			if (i % 2 == 0) {
+				got.ret = cmd_scan_parse (copy, len, &got.msg_type, &got.alarm_second,
+					got.message, &got.alarm_id, NULL);
+			} else {
+				got.ret = cmd_scan_parse (copy, len, &got.msg_type, &got.alarm_second,
+					got.message, &got.alarm_id, &text);
+				if (got.ret == 3) {
+					memcpy (got.message, text.text, text.len);
+					got.message[text.len] = '\0';
+				}
+			}
+			if (!same (&want, &got)) {
+				if (failures++ < 10)
+					printf ("parse mismatch (%s): \"%.*s\": %d/%d\n", impls[impl],
+						(int)len - 1, line, want.ret, got.ret);
+			}
+			if (impl == 0 && want.ret > 0 && want.ret <= 3)
+				(*fast)++;
+		}
+	}
+	return failures;
+}
+
+/*
+ * Split buf as a2's reader does, into pieces of at most LINE_SIZE - 1
+ * bytes, and optionally parse each. Returns the best GB/s of runs.
+ */
+static double run (const char *buf, long size, int runs, int parse, int reference)
+{
+	char line[LINE_SIZE], message[CMD_MESSAGE_MAX + 1];
+	unsigned int msg_type, alarm_second;
+	unsigned long alarm_id;
+	cmd_text_t text;
+	struct timespec start;
+	const char *p, *nl;
+	double ns, best = 0;
+	long len, lines, sum;
+	int i;
+
+	for (i = 0; i < runs; i++) {
+		lines = sum = 0;
+		clock_gettime (CLOCK_MONOTONIC, &start);
+		for (p = buf; p < buf + size; p += len) {
+			if (reference) {
+				nl = memchr (p, '\n', buf + size - p);
+				len = nl != NULL ? nl - p + 1 : buf + size - p;
+			} else {
+				len = cmd_scan_line (p, buf + size - p);
+				if (p + len < buf + size)
+					len++;
+			}
+			if (len >= LINE_SIZE)
+				len = LINE_SIZE - 1;
+			lines++;
+			if (!parse)
+				continue;
+			memcpy (line, p, len);
+			line[len] = '\0';
+			if (reference)
+				sum += get_cmd_type (line, &msg_type, &alarm_second, message, &alarm_id);
+			else
+				sum += cmd_scan_parse (line, len, &msg_type, &alarm_second, message, &alarm_id, &text);
+		}
+		ns = elapsed_ns (&start);
+		if (lines == 0 || sum < -lines)
+			fprintf (stderr, "nothing scanned\n");
+		if (best == 0 || size / ns > best)
+			best = size / ns;
+	}
+	return best;
+}
+
+int main (int argc, char *argv[])
+{
+	char *buf;
+	long n = 500000, cases = 200000, size = 0, i, failures, fast = 0;
+	unsigned int seed = 1;
+	int option, runs = 5, impl, saved_stderr, null_fd;
+
+	while ((option = getopt (argc, argv, "n:c:r:s:")) != -1) {
+		switch (option) {
+		case 'n':
+			n = atol (optarg);
+			break;
+		case 'c':
+			cases = atol (optarg);
+			break;
+		case 'r':
+			runs = atoi (optarg);
+			break;
+		case 's':
+			seed = (unsigned int)atoi (optarg);
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-n lines] [-c check lines] [-r runs] [-s seed]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (n < 1 || cases < 0 || runs < 1) {
+		fprintf (stderr, "-n and -r must be positive\n");
+		exit (1);
+	}
+	buf = malloc (n * LINE_SIZE);
+	if (buf == NULL)
+		errno_abort ("Allocate input");
+	srand (seed);
+	for (i = 0; i < n; i++) {
+		size += random_command (buf + size);
+		buf[size++] = '\n';
+	}
+
+	/*
+	 * get_cmd_type reports bad lines on stderr; keep that out of the
+	 * results but put stderr back for anything else.
+	 */
+	saved_stderr = dup (2);
+	null_fd = open ("/dev/null", O_WRONLY);
+	if (saved_stderr < 0 || null_fd < 0)
+		errno_abort ("Redirect stderr");
+	fflush (stderr);
+	dup2 (null_fd, 2);
+
+	failures = check_split (seed);
+	failures += check_parse (cases, seed, &fast);
+	printf ("command scan check: %ld damaged lines, %ld%% valid, %ld mismatches\n",
+		cases, cases ? fast * 100 / cases : 0, failures);
+
+	printf ("command scan benchmark: %ld lines, %.1f MB, seed %u\n", n, size / 1e6, seed);
+	printf ("%-10s %12s %12s\n", "scanner", "split GB/s", "parse GB/s");
+	printf ("%-10s %12.2f %12.2f\n", "reference",
+		run (buf, size, runs, 0, 1), run (buf, size, runs, 1, 1));
+	for (impl = 0; impl < NIMPLS; impl++) {
+		if (cmd_scan_use (impls[impl]) != 0) {
+			printf ("%-10s %12s %12s\n", impls[impl], "-", "-");
+			continue;
+		}
+		printf ("%-10s %12.2f %12.2f\n", impls[impl],
+			run (buf, size, runs, 0, 0), run (buf, size, runs, 1, 0));
+	}
+
+	fflush (stderr);
+	dup2 (saved_stderr, 2);
+	free (buf);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/*
+ * shm_bench.c
+ * Reads the shared memory stats segment of a busy a2 as fast as it
+ * can. a2 runs with -s and a fast virtual clock and publishes once a
+ * second, while a feeder thread keeps alarms of -T types coming. The reader takes copies with shm_stats_read for -t seconds
+ * and checks each against the one before: snapshots and counters only
+ * go forward, and no copy has more rows than the segment holds. A torn
+ * copy would break these sooner or later.
+ *
+ * It reports copies per second, the share of attempts that overlapped
+ * a publish and had to be retried, the snapshots a2 published in the
+ * time, and any copies that failed the checks, which fail the run.
+ *
+ * Usage: shm_bench [-t seconds] [-v scale] [-T types] [-a a2]
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "errors.h"
+#include "shm_stats.h"
+
+static FILE *to;
+static long types = 8;
+static volatile int feeding = 1;
+
+static double now_s (void)
+{
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Create a thread per type, then keep alarms coming in bursts.
+ */
+static void *feeder (void *arg)
+{
+	struct timespec pause = {0, 1000000};
+	long i, n = 0;
+
+	for (i = 1; i <= types; i++)
+		fprintf (to, "Create_Thread: MessageType(%ld)\n", i);
+	while (feeding) {
+		for (i = 0; i < 200; i++, n++)
+			fprintf (to, "%ld MessageType(%ld) shm %ld\n", 1 + n % 5, 1 + n % types, n);
+		fflush (to);
+		nanosleep (&pause, NULL);
+	}
+	return NULL;
+}
+
+/*
+ * Whether copy follows last as a real sequence of snapshots would.
+ */
+static int consistent (const shm_stats_t *last, const shm_stats_t *copy)
+{
+	if (copy->seq & 1 || copy->threads < 0 || copy->threads > SHM_STATS_THREADS
+			|| copy->types < 0 || copy->types > SHM_STATS_TYPES)
+		return 0;
+	if (last == NULL)
+		return 1;
+	return copy->generation >= last->generation
+		&& copy->published >= last->published
+		&& copy->counters.accepted >= last->counters.accepted
+		&& copy->counters.fired >= last->counters.fired
+		&& (copy->generation != last->generation
+			|| (copy->threads == last->threads && copy->types == last->types
+				&& copy->counters.fired == last->counters.fired));
+}
+
+int main (int argc, char *argv[])
+{
+	static shm_stats_t copies[2];
+	const shm_stats_t *segment = NULL;
+	shm_stats_t *copy, *last = NULL;
+	const char *a2 = "./a2", *scale = "1000";
+	char name[64];
+	struct timespec wait = {0, 10000000};
+	double seconds = 2, start, elapsed;
+	unsigned long first = 0;
+	long reads = 0, retries = 0, bad = 0;
+	int option, in[2], status, tries;
+	pthread_t thread;
+	pid_t pid;
+
+	while ((option = getopt (argc, argv, "t:v:T:a:")) != -1) {
+		switch (option) {
+		case 't':
+			seconds = atof (optarg);
+			break;
+		case 'v':
+			scale = optarg;
+			break;
+		case 'T':
+			types = atol (optarg);
+			break;
+		case 'a':
+			a2 = optarg;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-t seconds] [-v scale] [-T types] [-a a2]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (seconds <= 0 || types < 1) {
+		fprintf (stderr, "-t and -T must be positive\n");
+		exit (1);
+	}
+	signal (SIGPIPE, SIG_IGN);
+	snprintf (name, sizeof (name), "a2_shm_bench.%ld", (long)getpid ());
+
+	if (pipe (in) != 0)
+		errno_abort ("Create pipe");
+	fflush (stdout);
+	pid = fork ();
+	if (pid < 0)
+		errno_abort ("Fork");
+	if (pid == 0) {
+		dup2 (in[0], 0);
+		close (in[0]);
+		close (in[1]);
+		if (freopen ("/dev/null", "w", stdout) == NULL)
+			errno_abort ("Open /dev/null");
+		execl (a2, a2, "-v", scale, "-s", name, (char *)NULL);
+		errno_abort ("Exec a2");
+	}
+	close (in[0]);
+	to = fdopen (in[1], "w");
+	if (to == NULL)
+		errno_abort ("Open pipe");
+	status = pthread_create (&thread, NULL, feeder, NULL);
+	if (status != 0)
+		err_abort (status, "Create feeder");
+
+	for (tries = 0; tries < 200; tries++) {
+		if (shm_stats_attach (name, &segment) == 0)
+			break;
+		nanosleep (&wait, NULL);
+	}
+	if (segment == NULL) {
+		fprintf (stderr, "a2 did not create \"%s\"\n", name);
+		exit (1);
+	}
+
+	start = now_s ();
+	do {
+		copy = &copies[reads % 2];
+		status = shm_stats_read (segment, copy, &retries);
+		if (status != 0)
+			err_abort (status, "Read stats segment");
+		if (!consistent (last, copy))
+			bad++;
+		if (reads++ == 0)
+			first = copy->generation;
+		last = copy;
+	} while ((elapsed = now_s ()) - start < seconds);
+	elapsed -= start;
+
+	feeding = 0;
+	pthread_join (thread, NULL);
+	fclose (to);
+	if (waitpid (pid, &status, 0) < 0)
+		errno_abort ("Wait for a2");
+
+	printf ("shm stats benchmark: %.1f s, a2 -v %s, %ld types\n", elapsed, scale, types);
+	printf ("%12s %12s %12s %12s %12s\n", "copies/s", "retried %", "published", "alarms", "bad copies");
+	printf ("%12.0f %12.3f %12lu %12lu %12ld\n", reads / elapsed,
+		100.0 * retries / (reads + retries), last->generation - first,
+		last->counters.accepted, bad);
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+		fprintf (stderr, "a2 failed\n");
+		exit (1);
+	}
+	return bad == 0 ? 0 : 1;
+}
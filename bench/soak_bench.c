@@ -0,0 +1,305 @@
+/*
+ * soak_bench.c
+ * Runs a2 for a long stretch of alarm time and checks that it does
+ * not degrade. a2 runs on a fast virtual clock (-v, by default a day
+ * of alarm time every 10 seconds) with its stats segment (-s), while a
+ * feeder keeps -r alarms a second coming for -T types, with delays
+ * spread from a second to an hour, and every -c alarms terminates one
+ * type and creates its thread again, so cancellation and alarm removal
+ * run all along.
+ *
+ * Every -i seconds it samples a2's resident set from /proc, the alarms
+ * pending for each type from the segment and the rate alarms fired at
+ * between the last two snapshots, and prints a row. a2 publishes once
+ * a real second, so the rate is taken over the alarm time between
+ * snapshots scaled back by -v, and a sample that finds no new snapshot
+ * repeats the last rate. Once -t seconds are up it compares
+ * the last quarter of the samples with the first quarter after the -w
+ * warmup samples. It fails if the mean RSS grew by more than -R percent
+ * or the mean fires a second moved by more than -F percent. Growth of
+ * up to -K kB is not counted: a hiccup that backs alarms up grows the
+ * pool and touches more stack once, which is a step, not a leak.
+ *
+ * Usage: soak_bench [-t seconds] [-i seconds] [-v scale] [-r rate] [-T types] [-c alarms]
+ *        [-w samples] [-R percent] [-K kB] [-F percent] [-m mode] [-a a2]
+ */
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "errors.h"
+#include "shm_stats.h"
+
+#define SOAK_SAMPLES_MAX    4096
+
+typedef struct soak_sample_tag {
+	double              seconds;    /* real time since the start */
+	time_t              published;  /* alarm time */
+	long                rss;        /* kB */
+	long                pending;
+	double              fires;      /* a second, between the last two snapshots */
+} soak_sample_t;
+
+static FILE *to;
+static long types = 8, rate = 20000, churn = 5000;
+static volatile int feeding = 1;
+
+static double now_s (void)
+{
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Read VmRSS for pid from /proc; 0 if it cannot be read.
+ */
+static long rss_kb (pid_t pid)
+{
+	char path[64], line[256];
+	FILE *status;
+	long rss = 0;
+
+	snprintf (path, sizeof (path), "/proc/%ld/status", (long)pid);
+	status = fopen (path, "r");
+	if (status == NULL)
+		return 0;
+	while (fgets (line, sizeof (line), status) != NULL)
+		sscanf (line, "VmRSS: %ld", &rss);
+	fclose (status);
+	return rss;
+}
+
+/*
+ * Create a thread per type, then submit rate alarms a second in ticks
+ * of 10 ms, terminating and recreating a type every churn alarms.
+ */
+static void *feeder (void *arg)
+{
+	struct timespec tick;
+	long i, n = 0, per_tick = rate / 100 > 0 ? rate / 100 : 1, type;
+
+	for (i = 1; i <= types; i++)
+		fprintf (to, "Create_Thread: MessageType(%ld)\n", i);
+	fflush (to);
+	clock_gettime (CLOCK_MONOTONIC, &tick);
+	while (feeding) {
+		for (i = 0; i < per_tick; i++, n++) {
+			fprintf (to, "%ld MessageType(%ld) soak %ld\n", 1 + n * 7 % 3600, 1 + n % types, n);
+			if ((n + 1) % churn == 0) {
+				type = 1 + (n / churn) % types;
+				fprintf (to, "Terminate_Thread: MessageType(%ld)\n", type);
+				fprintf (to, "Create_Thread: MessageType(%ld)\n", type);
+			}
+		}
+		if (fflush (to) == EOF)
+			break;
+		tick.tv_nsec += 10000000;
+		if (tick.tv_nsec >= 1000000000) {
+			tick.tv_sec++;
+			tick.tv_nsec -= 1000000000;
+		}
+		while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL) == EINTR)
+			;
+	}
+	return NULL;
+}
+
+/*
+ * The mean of field over samples first to last - 1.
+ */
+static double mean (const soak_sample_t *samples, long first, long last, int field)
+{
+	double sum = 0;
+	long i;
+
+	for (i = first; i < last; i++)
+		sum += field == 0 ? (double)samples[i].rss : samples[i].fires;
+	return last > first ? sum / (last - first) : 0;
+}
+
+int main (int argc, char *argv[])
+{
+	static shm_stats_t copy;
+	static soak_sample_t samples[SOAK_SAMPLES_MAX];
+	const shm_stats_t *segment = NULL;
+	const char *a2 = "./a2", *scale = "8640", *mode = "poll";
+	char name[64];
+	struct timespec wait = {0, 10000000}, next;
+	double seconds = 30, interval = 1, start, rss_drift, fire_drift, base, first_rss, last_rss;
+	double rss_limit = 20, rss_slack = 2048, fire_limit = 25;
+	unsigned long fired = 0;
+	time_t fired_at = 0;
+	double fire_rate = 0;
+	long count = 0, warmup = 2, quarter, i, pending;
+	time_t first_published = 0;
+	int option, in[2], status, tries, failed = 0;
+	pthread_t thread;
+	pid_t pid;
+
+	while ((option = getopt (argc, argv, "t:i:v:r:T:c:w:R:K:F:m:a:")) != -1) {
+		switch (option) {
+		case 't':
+			seconds = atof (optarg);
+			break;
+		case 'i':
+			interval = atof (optarg);
+			break;
+		case 'v':
+			scale = optarg;
+			break;
+		case 'r':
+			rate = atol (optarg);
+			break;
+		case 'T':
+			types = atol (optarg);
+			break;
+		case 'c':
+			churn = atol (optarg);
+			break;
+		case 'w':
+			warmup = atol (optarg);
+			break;
+		case 'R':
+			rss_limit = atof (optarg);
+			break;
+		case 'K':
+			rss_slack = atof (optarg);
+			break;
+		case 'F':
+			fire_limit = atof (optarg);
+			break;
+		case 'm':
+			mode = optarg;
+			break;
+		case 'a':
+			a2 = optarg;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-t seconds] [-i seconds] [-v scale] [-r rate] [-T types] [-c alarms]\n"
+				"       [-w samples] [-R percent] [-K kB] [-F percent] [-m mode] [-a a2]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (seconds <= 0 || interval <= 0 || rate < 1 || types < 1 || churn < 1 || warmup < 0) {
+		fprintf (stderr, "-t, -i, -r, -T and -c must be positive\n");
+		exit (1);
+	}
+	if (seconds / interval - warmup < 8 || seconds / interval > SOAK_SAMPLES_MAX) {
+		fprintf (stderr, "-t / -i must leave 8 to %d samples after warmup\n", SOAK_SAMPLES_MAX);
+		exit (1);
+	}
+	signal (SIGPIPE, SIG_IGN);
+	snprintf (name, sizeof (name), "a2_soak_bench.%ld", (long)getpid ());
+
+	if (pipe (in) != 0)
+		errno_abort ("Create pipe");
+	fflush (stdout);
+	pid = fork ();
+	if (pid < 0)
+		errno_abort ("Fork");
+	if (pid == 0) {
+		dup2 (in[0], 0);
+		close (in[0]);
+		close (in[1]);
+		if (freopen ("/dev/null", "w", stdout) == NULL)
+			errno_abort ("Open /dev/null");
+		execl (a2, a2, "-v", scale, "-s", name, "-m", mode, (char *)NULL);
+		errno_abort ("Exec a2");
+	}
+	close (in[0]);
+	to = fdopen (in[1], "w");
+	if (to == NULL)
+		errno_abort ("Open pipe");
+	for (tries = 0; tries < 200; tries++) {
+		if (shm_stats_attach (name, &segment) == 0)
+			break;
+		nanosleep (&wait, NULL);
+	}
+	if (segment == NULL) {
+		fprintf (stderr, "a2 did not create \"%s\"\n", name);
+		kill (pid, SIGKILL);
+		exit (1);
+	}
+	status = pthread_create (&thread, NULL, feeder, NULL);
+	if (status != 0)
+		err_abort (status, "Create feeder");
+
+	printf ("soak benchmark: %.0f s, a2 -m %s -v %s, %ld alarms/s over %ld types, churn every %ld\n",
+		seconds, mode, scale, rate, types, churn);
+	printf ("%8s %8s %10s %10s %10s\n", "real s", "days", "rss kB", "pending", "fires/s");
+	fflush (stdout);
+	start = now_s ();
+	clock_gettime (CLOCK_MONOTONIC, &next);
+	while (count < (long)(seconds / interval)) {
+		next.tv_sec += (time_t)interval;
+		next.tv_nsec += (long)((interval - (time_t)interval) * 1e9);
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+			;
+		status = shm_stats_read (segment, &copy, NULL);
+		if (status != 0)
+			err_abort (status, "Read stats segment");
+		for (i = 0, pending = 0; i < copy.types; i++)
+			pending += copy.type[i].waiting + copy.type[i].queued;
+		if (count == 0)
+			first_published = copy.published;
+		samples[count].seconds = now_s () - start;
+		samples[count].published = copy.published;
+		samples[count].rss = rss_kb (pid);
+		samples[count].pending = pending;
+		if (count > 0 && copy.published > fired_at)
+			fire_rate = (copy.counters.fired - fired) * atof (scale) / (copy.published - fired_at);
+		if (count == 0 || copy.published > fired_at) {
+			fired = copy.counters.fired;
+			fired_at = copy.published;
+		}
+		samples[count].fires = fire_rate;
+		printf ("%8.1f %8.2f %10ld %10ld %10.0f\n", samples[count].seconds,
+			(copy.published - first_published) / 86400.0, samples[count].rss,
+			pending, samples[count].fires);
+		fflush (stdout);
+		if (samples[count].rss == 0) {
+			fprintf (stderr, "a2 is gone\n");
+			exit (1);
+		}
+		count++;
+	}
+
+	feeding = 0;
+	pthread_join (thread, NULL);
+	fclose (to);
+	if (waitpid (pid, &status, 0) < 0)
+		errno_abort ("Wait for a2");
+	if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+		fprintf (stderr, "a2 failed\n");
+		exit (1);
+	}
+
+	/*
+	 *The first sample after the warmup only counts fires from the
+	 *end of it, so the quarters start one later
+	 */
+	quarter = (count - warmup - 1) / 4;
+	first_rss = mean (samples, warmup + 1, warmup + 1 + quarter, 0);
+	last_rss = mean (samples, count - quarter, count, 0);
+	rss_drift = first_rss > 0 ? 100 * (last_rss - first_rss) / first_rss : 0;
+	base = mean (samples, warmup + 1, warmup + 1 + quarter, 1);
+	fire_drift = base > 0 ? 100 * (mean (samples, count - quarter, count, 1) - base) / base : 0;
+	printf ("rss drift %+.1f%% (limit %.0f%% over %.0f kB), fires/s drift %+.1f%% (limit %.0f%%), %.2f days\n",
+		rss_drift, rss_limit, rss_slack, fire_drift, fire_limit,
+		(samples[count - 1].published - first_published) / 86400.0);
+	if (rss_drift > rss_limit && last_rss - first_rss > rss_slack) {
+		fprintf (stderr, "a2's resident set grew by %.1f%%\n", rss_drift);
+		failed = 1;
+	}
+	if (fire_drift > fire_limit || fire_drift < -fire_limit) {
+		fprintf (stderr, "a2's fire rate moved by %.1f%%\n", fire_drift);
+		failed = 1;
+	}
+	return failed;
+}
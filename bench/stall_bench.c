@@ -0,0 +1,215 @@
+/*
+ * stall_bench.c
+ * Stalls the reader of a2's output and checks whether a2 keeps
+ * scheduling alarms under each -o policy. For each policy it starts
+ * a2 on the virtual clock with a small output ring (-b) and its stats
+ * segment (-s), feeds it -n alarms due a second later, and reads none
+ * of its output for -t seconds. At the end of the stall it reads how
+ * many alarms a2 had accepted and fired from the segment, then drains
+ * the output and counts the lines that got through.
+ *
+ *   block        a2 waits for the reader, as without -o
+ *   drop-oldest  the oldest unwritten lines are dropped
+ *   drop-new     new lines are dropped
+ *   spill        new lines go to a file
+ *
+ * Under every policy but block, all the alarms must have been accepted
+ * and fired while the reader was stalled, or the run fails.
+ *
+ * Usage: stall_bench [-n alarms] [-t seconds] [-b bytes] [-v scale] [-a a2] [-m policy]
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "errors.h"
+#include "shm_stats.h"
+
+static const char *policies[] = { "block", "drop-oldest", "drop-new", "spill" };
+
+static long alarms = 2000;
+
+/*
+ * Create a thread and submit the alarms, however long a2 takes to read
+ * them.
+ */
+static void *feeder (void *arg)
+{
+	FILE *feed = (FILE *)arg;
+	long i;
+
+	fprintf (feed, "Create_Thread: MessageType(1)\n");
+	for (i = 0; i < alarms; i++)
+		fprintf (feed, "1 MessageType(1) stalled reader alarm %ld\n", i);
+	fflush (feed);
+	return NULL;
+}
+
+/*
+ * Count the lines of a2's output until it exits.
+ */
+static void *reader (void *arg)
+{
+	FILE *out = (FILE *)arg;
+	long *lines = malloc (sizeof (long));
+	int c;
+
+	if (lines == NULL)
+		errno_abort ("Allocate line count");
+	*lines = 0;
+	while ((c = getc (out)) != EOF)
+		*lines += c == '\n';
+	fclose (out);
+	return lines;
+}
+
+static void bench_policy (const char *policy, const char *a2, double stall,
+	const char *bytes, const char *scale)
+{
+	static shm_stats_t copy;
+	const shm_stats_t *segment = NULL;
+	char name[64], spill[64], option[96], pool[32];
+	struct timespec wait = {0, 10000000}, pause;
+	unsigned long accepted, fired;
+	int in[2], out[2], status, tries;
+	pthread_t feeder_id, reader_id;
+	FILE *feed;
+	long *lines;
+	pid_t pid;
+
+	snprintf (name, sizeof (name), "a2_stall_bench.%ld", (long)getpid ());
+	snprintf (spill, sizeof (spill), "/tmp/a2_stall_bench.%ld", (long)getpid ());
+	if (strcmp (policy, "spill") == 0)
+		snprintf (option, sizeof (option), "spill:%s", spill);
+	else
+		snprintf (option, sizeof (option), "%s", policy);
+	snprintf (pool, sizeof (pool), "%ld", alarms);
+	unlink (spill);
+
+	if (pipe (in) != 0 || pipe (out) != 0)
+		errno_abort ("Pipe");
+	/*
+	 *Keep the pipe small so the ring fills soon after the reader stops
+	 */
+	fcntl (out[0], F_SETPIPE_SZ, 4096);
+	pid = fork ();
+	if (pid < 0)
+		errno_abort ("Fork");
+	if (pid == 0) {
+		dup2 (in[0], 0);
+		dup2 (out[1], 1);
+		close (in[0]);
+		close (in[1]);
+		close (out[0]);
+		close (out[1]);
+		execl (a2, a2, "-v", scale, "-p", pool, "-s", name, "-o", option, "-b", bytes,
+			(char *)NULL);
+		errno_abort ("Exec a2");
+	}
+	close (in[0]);
+	close (out[1]);
+	feed = fdopen (in[1], "w");
+	if (feed == NULL)
+		errno_abort ("Open feed");
+	status = pthread_create (&feeder_id, NULL, feeder, feed);
+	if (status != 0)
+		err_abort (status, "Create feeder");
+	for (tries = 0; tries < 200 && segment == NULL; tries++)
+		if (shm_stats_attach (name, &segment) != 0)
+			nanosleep (&wait, NULL);
+	if (segment == NULL) {
+		fprintf (stderr, "a2 did not create \"%s\"\n", name);
+		kill (pid, SIGKILL);
+		exit (1);
+	}
+
+	pause.tv_sec = (time_t)stall;
+	pause.tv_nsec = (long)((stall - pause.tv_sec) * 1e9);
+	nanosleep (&pause, NULL);
+	status = shm_stats_read (segment, &copy, NULL);
+	if (status != 0)
+		err_abort (status, "Read stats segment");
+	accepted = copy.counters.accepted;
+	fired = copy.counters.fired;
+
+	status = pthread_create (&reader_id, NULL, reader, fdopen (out[0], "r"));
+	if (status != 0)
+		err_abort (status, "Create reader");
+	pthread_join (feeder_id, NULL);
+	for (tries = 0; tries < 1000; tries++) {
+		status = shm_stats_read (segment, &copy, NULL);
+		if (status != 0)
+			err_abort (status, "Read stats segment");
+		if (copy.counters.fired == (unsigned long)alarms)
+			break;
+		nanosleep (&wait, NULL);
+	}
+	fclose (feed);
+	if (waitpid (pid, &status, 0) < 0)
+		errno_abort ("Wait for a2");
+	pthread_join (reader_id, (void **)&lines);
+	unlink (spill);
+
+	printf ("%-12s %10lu %10lu %10ld %10lu %10lu %10lu\n", policy, accepted, fired, *lines,
+		copy.counters.out_dropped, copy.counters.out_spilled, copy.counters.out_waits);
+	free (lines);
+	if (strcmp (policy, "block") != 0
+			&& (accepted != (unsigned long)alarms || fired != (unsigned long)alarms)) {
+		fprintf (stderr, "%s: a2 stopped scheduling while its reader was stalled\n", policy);
+		exit (1);
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	const char *a2 = "./a2", *scale = "100", *bytes = "16384", *only = NULL;
+	double stall = 1;
+	int option, i;
+
+	while ((option = getopt (argc, argv, "n:t:b:v:a:m:")) != -1) {
+		switch (option) {
+		case 'n':
+			alarms = atol (optarg);
+			break;
+		case 't':
+			stall = atof (optarg);
+			break;
+		case 'b':
+			bytes = optarg;
+			break;
+		case 'v':
+			scale = optarg;
+			break;
+		case 'a':
+			a2 = optarg;
+			break;
+		case 'm':
+			only = optarg;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-n alarms] [-t seconds] [-b bytes] [-v scale] [-a a2] [-m policy]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (alarms < 1 || stall <= 0) {
+		fprintf (stderr, "-n and -t must be positive\n");
+		exit (1);
+	}
+	signal (SIGPIPE, SIG_IGN);
+
+	printf ("stall benchmark: %ld alarms, reader stalled %.1f s, %s byte ring, clock x%s\n",
+		alarms, stall, bytes, scale);
+	printf ("%-12s %10s %10s %10s %10s %10s %10s\n", "policy", "accepted", "fired",
+		"lines out", "dropped", "spilled", "waits");
+	printf ("%-12s %10s %10s\n", "", "(in stall)", "(in stall)");
+	fflush (stdout);
+	for (i = 0; i < 4; i++) {
+		if (only != NULL && strcmp (only, policies[i]) != 0)
+			continue;
+		bench_policy (policies[i], a2, stall, bytes, scale);
+		fflush (stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * timerq_bench.c
+ * Runs the same workloads against every timer queue backend so the
+ * one passed to a2 -q can be chosen with numbers rather than guesses.
+ *
+ *   hold    queue kept at -n entries; each op pops the earliest and
+ *           re-inserts it a random 1..300 "seconds" later, which is
+ *           what an alarm thread with a steady load does
+ *   drain   -n random inserts followed by popping every entry
+ *   cancel  -n inserts, every other entry removed from the middle,
+ *           then the rest drained (Terminate_Thread and rescheduling)
+ *
+ * Every pop is checked against the previous one, so a backend that
+ * returns entries out of order fails the run instead of looking fast.
+ *
+ * Usage: timerq_bench [-n entries] [-m hold ops] [-s seed] [-q backend]
+ */
+#include <time.h>
+#include "errors.h"
+#include "timer_queue.h"
+
+typedef struct bench_item_tag {
+	timerq_node_t       node;
+	long                id;
+} bench_item_t;
+
+static double elapsed_ns (struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime (CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static void check_order (timerq_node_t *node, long long *last, const char *what)
+{
+	if (node == NULL || node->key < *last) {
+		fprintf (stderr, "%s: entries out of order\n", what);
+		exit (1);
+	}
+	*last = node->key;
+}
+
+static void insert_or_die (timerq_t *q, bench_item_t *item)
+{
+	int status = timerq_insert (q, &item->node);
+
+	if (status != 0)
+		err_abort (status, "Insert timer queue");
+}
+
+static double bench_hold (timerq_kind_t kind, bench_item_t *items, long n, long m)
+{
+	timerq_t q;
+	timerq_node_t *node;
+	struct timespec start;
+	long long last = 0;
+	long i;
+	int status;
+
+	status = timerq_init (&q, kind);
+	if (status != 0)
+		err_abort (status, "Init timer queue");
+	for (i = 0; i < n; i++) {
+		items[i].node.key = rand () % 300;
+		insert_or_die (&q, &items[i]);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < m; i++) {
+		node = timerq_pop (&q);
+		check_order (node, &last, "hold");
+		node->key += 1 + rand () % 300;
+		insert_or_die (&q, (bench_item_t *)node);
+	}
+	timerq_destroy (&q);
+	return elapsed_ns (&start) / m;
+}
+
+static double bench_drain (timerq_kind_t kind, bench_item_t *items, long n)
+{
+	timerq_t q;
+	struct timespec start;
+	long long last = 0;
+	long i;
+	int status;
+
+	status = timerq_init (&q, kind);
+	if (status != 0)
+		err_abort (status, "Init timer queue");
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+		items[i].node.key = rand () % (n + 1);
+		insert_or_die (&q, &items[i]);
+	}
+	for (i = 0; i < n; i++)
+		check_order (timerq_pop (&q), &last, "drain");
+	timerq_destroy (&q);
+	return elapsed_ns (&start) / (2 * n);
+}
+
+static double bench_cancel (timerq_kind_t kind, bench_item_t *items, long n)
+{
+	timerq_t q;
+	struct timespec start;
+	long long last = 0;
+	long i;
+	int status;
+
+	status = timerq_init (&q, kind);
+	if (status != 0)
+		err_abort (status, "Init timer queue");
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+		items[i].node.key = rand () % (n + 1);
+		insert_or_die (&q, &items[i]);
+	}
+	for (i = 0; i < n; i += 2)
+		timerq_remove (&q, &items[i].node);
+	while (q.count > 0)
+		check_order (timerq_pop (&q), &last, "cancel");
+	timerq_destroy (&q);
+	return elapsed_ns (&start) / (n + n / 2 + (n + 1) / 2);
+}
+
+int main (int argc, char *argv[])
+{
+	bench_item_t *items;
+	long n = 10000, m = 200000, i;
+	unsigned int seed = 1;
+	int option, kind, only = -1;
+	timerq_kind_t parsed;
+
+	while ((option = getopt (argc, argv, "n:m:s:q:")) != -1) {
+		switch (option) {
+		case 'n':
+			n = atol (optarg);
+			break;
+		case 'm':
+			m = atol (optarg);
+			break;
+		case 's':
+			seed = (unsigned int)atoi (optarg);
+			break;
+		case 'q':
+			if (timerq_kind_parse (optarg, &parsed) != 0) {
+				fprintf (stderr, "Unknown timer queue \"%s\"\n", optarg);
+				exit (1);
+			}
+			only = parsed;
+			break;
+		default:
+			fprintf (stderr, "Usage: %s [-n entries] [-m hold ops] [-s seed] [-q backend]\n", argv[0]);
+			exit (1);
+		}
+	}
+	if (n < 1 || m < 1) {
+		fprintf (stderr, "-n and -m must be positive\n");
+		exit (1);
+	}
+	items = calloc (n, sizeof (*items));
+	if (items == NULL)
+		errno_abort ("Allocate items");
+	for (i = 0; i < n; i++)
+		items[i].id = i;
+
+	printf ("timer queue benchmark: %ld entries, %ld hold ops, seed %u\n", n, m, seed);
+	printf ("%-8s %12s %12s %12s\n", "backend", "hold ns/op", "drain ns/op", "cancel ns/op");
+	for (kind = 0; kind < TIMERQ_NKINDS; kind++) {
+		double hold, drain, cancel;
+
+		if (only >= 0 && kind != only)
+			continue;
+		srand (seed);
+		hold = bench_hold ((timerq_kind_t)kind, items, n, m);
+		srand (seed);
+		drain = bench_drain ((timerq_kind_t)kind, items, n);
+		srand (seed);
+		cancel = bench_cancel ((timerq_kind_t)kind, items, n);
+		printf ("%-8s %12.1f %12.1f %12.1f\n",
+			timerq_kind_name ((timerq_kind_t)kind), hold, drain, cancel);
+	}
+	free (items);
+	return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * cmd_scan.c
+ * The line splitter and tokenizer declared in cmd_scan.h.
+ *
+ * Two kernels are vectorised. newline finds the first '\n' in a
+ * buffer, which is all splitting takes. masks classifies the first
+ * CMD_SCAN_WINDOW bytes of a line at once, giving one bit per byte
+ * for whitespace as sscanf sees it and one for blanks (space and
+ * tab), so the tokenizer finds every field boundary it needs with a
+ * count of trailing zeros instead of testing bytes one at a time.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "command.h"
+#include "cmd_scan.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+# include <immintrin.h>
+# define CMD_SCAN_X86
+#endif
+
+#define CMD_SCAN_WINDOW     64
+#define DIGITS_MAX          9       /* more might overflow the int sscanf reads */
+#define TOKEN_MAX           19      /* longer tokens are left to get_cmd_type */
+
+typedef struct cmd_masks_tag {
+	uint64_t            space;      /* ' ', '\t', '\n', '\v', '\f', '\r' */
+	uint64_t            blank;      /* ' ', '\t' */
+} cmd_masks_t;
+
+typedef struct cmd_scan_kernels_tag {
+	const char          *name;
+	long                (*newline) (const char *buf, long len);
+	void                (*masks) (const unsigned char *window, cmd_masks_t *masks);
+} cmd_scan_kernels_t;
+
+static long newline_scalar (const char *buf, long len)
+{
+	long i;
+
+	for (i = 0; i < len && buf[i] != '\n'; i++)
+		;
+	return i;
+}
+
+static void masks_scalar (const unsigned char *window, cmd_masks_t *masks)
+{
+	uint64_t bit;
+	int i;
+
+	masks->space = masks->blank = 0;
+	for (i = 0; i < CMD_SCAN_WINDOW; i++) {
+		bit = (uint64_t)1 << i;
+		if (window[i] == ' ' || window[i] == '\t')
+			masks->blank |= bit;
+		if (window[i] == ' ' || (window[i] >= '\t' && window[i] <= '\r'))
+			masks->space |= bit;
+	}
+}
+
+#ifdef CMD_SCAN_X86
+/*
+ * SSE2 is part of x86-64, so these need no target attribute there.
+ * Bytes of 0x80 and above compare as negative, which keeps them out
+ * of the '\t'..'\r' range test.
+ */
+__attribute__ ((target ("sse2")))
+static long newline_sse2 (const char *buf, long len)
+{
+	__m128i nl = _mm_set1_epi8 ('\n');
+	long i;
+	int hit;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		hit = _mm_movemask_epi8 (_mm_cmpeq_epi8 (
+			_mm_loadu_si128 ((const __m128i *)(buf + i)), nl));
+		if (hit != 0)
+			return i + __builtin_ctz (hit);
+	}
+	return i + newline_scalar (buf + i, len - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void masks_sse2 (const unsigned char *window, cmd_masks_t *masks)
+{
+	__m128i sp = _mm_set1_epi8 (' '), tab = _mm_set1_epi8 ('\t');
+	__m128i lo = _mm_set1_epi8 ('\t' - 1), hi = _mm_set1_epi8 ('\r' + 1);
+	__m128i v, blank, space;
+	int i;
+
+	masks->space = masks->blank = 0;
+	for (i = 0; i < CMD_SCAN_WINDOW; i += 16) {
+		v = _mm_loadu_si128 ((const __m128i *)(window + i));
+		blank = _mm_or_si128 (_mm_cmpeq_epi8 (v, sp), _mm_cmpeq_epi8 (v, tab));
+		space = _mm_or_si128 (_mm_cmpeq_epi8 (v, sp),
+			_mm_and_si128 (_mm_cmpgt_epi8 (v, lo), _mm_cmplt_epi8 (v, hi)));
+		masks->blank |= (uint64_t)(unsigned)_mm_movemask_epi8 (blank) << i;
+		masks->space |= (uint64_t)(unsigned)_mm_movemask_epi8 (space) << i;
+	}
+}
+
+__attribute__ ((target ("avx2")))
+static long newline_avx2 (const char *buf, long len)
+{
+	__m256i nl = _mm256_set1_epi8 ('\n');
+	long i;
+	unsigned hit;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		hit = (unsigned)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (
+			_mm256_loadu_si256 ((const __m256i *)(buf + i)), nl));
+		if (hit != 0)
+			return i + __builtin_ctz (hit);
+	}
+	return i + newline_sse2 (buf + i, len - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void masks_avx2 (const unsigned char *window, cmd_masks_t *masks)
+{
+	__m256i sp = _mm256_set1_epi8 (' '), tab = _mm256_set1_epi8 ('\t');
+	__m256i lo = _mm256_set1_epi8 ('\t' - 1), hi = _mm256_set1_epi8 ('\r' + 1);
+	__m256i v, blank, space;
+	int i;
+
+	masks->space = masks->blank = 0;
+	for (i = 0; i < CMD_SCAN_WINDOW; i += 32) {
+		v = _mm256_loadu_si256 ((const __m256i *)(window + i));
+		blank = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, sp), _mm256_cmpeq_epi8 (v, tab));
+		space = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, sp),
+			_mm256_and_si256 (_mm256_cmpgt_epi8 (v, lo), _mm256_cmpgt_epi8 (hi, v)));
+		masks->blank |= (uint64_t)(unsigned)_mm256_movemask_epi8 (blank) << i;
+		masks->space |= (uint64_t)(unsigned)_mm256_movemask_epi8 (space) << i;
+	}
+}
+#endif
+
+static const cmd_scan_kernels_t kernels[] = {
+	{"scalar", newline_scalar, masks_scalar},
+#ifdef CMD_SCAN_X86
+	{"sse2", newline_sse2, masks_sse2},
+	{"avx2", newline_avx2, masks_avx2},
+#endif
+};
+
+#define NKERNELS    ((int)(sizeof (kernels) / sizeof (kernels[0])))
+
+static const cmd_scan_kernels_t *active;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static int kernel_supported (const cmd_scan_kernels_t *k)
+{
+#ifdef CMD_SCAN_X86
+	if (strcmp (k->name, "sse2") == 0)
+		return __builtin_cpu_supports ("sse2");
+	if (strcmp (k->name, "avx2") == 0)
+		return __builtin_cpu_supports ("avx2");
+#endif
+	return 1;
+}
+
+/*
+ * Pick the last, and so widest, kernel set the CPU supports.
+ */
+static void select_kernels (void)
+{
+	int i;
+
+	__builtin_cpu_init ();
+	for (i = 0; i < NKERNELS; i++)
+		if (kernel_supported (&kernels[i]))
+			active = &kernels[i];
+}
+
+static const cmd_scan_kernels_t *get_kernels (void)
+{
+	pthread_once (&select_once, select_kernels);
+	return active;
+}
+
+/*
+ * Name of the kernel set in use: "scalar", "sse2" or "avx2".
+ */
+const char *cmd_scan_impl (void)
+{
+	return get_kernels ()->name;
+}
+
+/*
+ * Switch to the named kernel set, for benchmarks and checks. Returns
+ * 0, or -1 if the name is unknown or the CPU does not support it.
+ */
+int cmd_scan_use (const char *name)
+{
+	int i;
+
+	get_kernels ();
+	for (i = 0; i < NKERNELS; i++) {
+		if (strcmp (name, kernels[i].name) == 0 && kernel_supported (&kernels[i])) {
+			active = &kernels[i];
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Offset of the first '\n' in buf, or len if there is none.
+ */
+long cmd_scan_line (const char *buf, long len)
+{
+	return get_kernels ()->newline (buf, len);
+}
+
+/*
+ * Read the run of 1 to DIGITS_MAX decimal digits at line[*pos] and
+ * advance past it. Returns -1 if there is no such run.
+ */
+static long scan_number (const char *line, long len, long *pos)
+{
+	long value = 0, i = *pos;
+
+	while (i < len && i - *pos < DIGITS_MAX && line[i] >= '0' && line[i] <= '9')
+		value = value * 10 + (line[i++] - '0');
+	if (i == *pos || (i < len && line[i] >= '0' && line[i] <= '9'))
+		return -1;
+	*pos = i;
+	return value;
+}
+
+/*
+ * Find the field that starts after the blanks at offset from and
+ * set *start and *end to its bounds. Returns 0, or -1 if the field
+ * is missing, is preceded by whitespace other than blanks or runs
+ * past the window while the line goes on.
+ */
+static int scan_field (const cmd_masks_t *m, long len, long from, long *start, long *end)
+{
+	uint64_t rest;
+	long window = len < CMD_SCAN_WINDOW ? len : CMD_SCAN_WINDOW;
+
+	if (from >= window)
+		return -1;
+	rest = ~m->blank & (~(uint64_t)0 << from);
+	if (rest == 0 || (*start = __builtin_ctzll (rest)) >= window)
+		return -1;
+	if (m->space & ((uint64_t)1 << *start))
+		return -1;
+	rest = m->space & (~(uint64_t)0 << *start);
+	if (rest != 0 && __builtin_ctzll (rest) < window)
+		*end = __builtin_ctzll (rest);
+	else if (len <= CMD_SCAN_WINDOW)
+		*end = len;
+	else
+		return -1;
+	return 0;
+}
+
+/*
+ * Message type from a "MessageType(N" token, or -1.
+ */
+static long scan_type (const char *line, long start, long end)
+{
+	static const char prefix[] = "MessageType(";
+	long pos = start + sizeof (prefix) - 1;
+
+	if (end - start > TOKEN_MAX || end <= pos
+			|| memcmp (line + start, prefix, sizeof (prefix) - 1) != 0)
+		return -1;
+	return scan_number (line, end, &pos);
+}
+
+/*
+ * Parse one line of input, of length len, as get_cmd_type would and
+ * with the same outputs and return value. With text given, an alarm's
+ * message is only located, not copied into message.
+ */
+int cmd_scan_parse (char *line, long len, unsigned int *msg_type,
+	unsigned int *alarm_second, char *message, unsigned long *alarm_id,
+	cmd_text_t *text)
+{
+	static const char create[] = "Create_Thread:", terminate[] = "Terminate_Thread:";
+	const cmd_scan_kernels_t *k = get_kernels ();
+	unsigned char window[CMD_SCAN_WINDOW];
+	cmd_masks_t m;
+	long pos = 0, second, type, start, end, size;
+	int kind = 0, ret;
+
+	memcpy (window, line, len < CMD_SCAN_WINDOW ? len : CMD_SCAN_WINDOW);
+	if (len < CMD_SCAN_WINDOW)
+		memset (window + len, 0, CMD_SCAN_WINDOW - len);
+	k->masks (window, &m);
+
+	if (len > 0 && line[0] >= '0' && line[0] <= '9') {
+		/*
+		 * "<seconds> MessageType(N) <message>"
+		 */
+		second = scan_number (line, len, &pos);
+		if (second >= 0 && pos < len && (m.blank & ((uint64_t)1 << pos))
+				&& scan_field (&m, len, pos, &start, &end) == 0
+				&& (type = scan_type (line, start, end)) >= 0
+				&& scan_field (&m, len, end, &start, &end) == 0) {
+			size = k->newline (line + start, len - start);
+			if (size > CMD_MESSAGE_MAX)
+				size = CMD_MESSAGE_MAX;
+			if (text != NULL) {
+				text->text = line + start;
+				text->len = size;
+			} else {
+				memcpy (message, line + start, size);
+				message[size] = '\0';
+			}
+			*alarm_second = (unsigned int)second;
+			*msg_type = (unsigned int)type;
+			return 3;
+		}
+	} else if (len > (long)sizeof (create) && memcmp (line, create, sizeof (create) - 1) == 0) {
+		pos = sizeof (create) - 1;
+		kind = 1;
+	} else if (len > (long)sizeof (terminate) && memcmp (line, terminate, sizeof (terminate) - 1) == 0) {
+		pos = sizeof (terminate) - 1;
+		kind = 2;
+	}
+	if (kind != 0 && (m.blank & ((uint64_t)1 << pos))
+			&& scan_field (&m, len, pos, &start, &end) == 0
+			&& (type = scan_type (line, start, end)) >= 1) {
+		*msg_type = (unsigned int)type;
+		return kind;
+	}
+	ret = get_cmd_type (line, msg_type, alarm_second, message, alarm_id);
+	if (text != NULL && ret == 3) {
+		text->text = message;
+		text->len = strlen (message);
+	}
+	return ret;
+}
@@ -0,0 +1,33 @@
+/*
+ * cmd_scan.h
+ * Vectorised line splitting and command tokenizing for bulk input.
+ * The kernels come in scalar, SSE2 and AVX2 versions; the best one
+ * the CPU supports is picked the first time any of them is used.
+ *
+ * cmd_scan_parse gives exactly the result get_cmd_type would. It
+ * handles the common well-formed alarm, Create_Thread and
+ * Terminate_Thread lines itself and hands anything else, including
+ * every line that is an error, to get_cmd_type.
+ *
+ * Given a cmd_text_t, cmd_scan_parse does not copy an alarm's message
+ * out of line but points text at it there, so the caller can copy it
+ * once, straight into the alarm. Only a line get_cmd_type had to parse
+ * has its message in the message buffer, and text then points at that.
+ */
+#ifndef __cmd_scan_h
+#define __cmd_scan_h
+
+typedef struct cmd_text_tag {
+	const char          *text;      /* not null terminated */
+	long                len;
+} cmd_text_t;
+
+long cmd_scan_line (const char *buf, long len);
+int cmd_scan_parse (char *line, long len, unsigned int *msg_type,
+	unsigned int *alarm_second, char *message, unsigned long *alarm_id,
+	cmd_text_t *text);
+
+const char *cmd_scan_impl (void);
+int cmd_scan_use (const char *name);
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * command.c
+ * Parsing of the commands main reads. get_cmd_type is the reference
+ * parser; cmd_scan.c has a faster path that must agree with it.
+ */
+#include "errors.h"
+#include "command.h"
+
+/**
+Get command type.
+\param line information that user input.
+\param msg_type Output message type.
+\param alarm_second If the command is message command, after the alarm_second,
+					message will be displayed.
+\param message If the command is message command. message contains the message to be
+				displayed.
+\param alarm_id If the command is reschedule command, the ID of the alarm to move;
+				alarm_second is then its new delay.
+\return 1 means create thread command, 2 means terminate command, 3 means message command,
+		4 means reschedule command, 5 means stats command, 6 means thread stats command,
+		7 means barrier command, 8 means memory stats command, -1 means bad command.
+*/
+int get_cmd_type(char* line, unsigned int* msg_type, unsigned int* alarm_second, char* message,
+		unsigned long* alarm_id)
+{
+	char cmd[20];
+	char str_msg_type[CMD_TOKEN_MAX + 1];
+	int ret_value, seconds;
+
+	/*
+* Parse input line into seconds (%d) and a message
+* (%128[^\n]), consisting of up to 128 characters
+* separated from the seconds by whitespace.
+*/
+
+	if(strncmp(line, "Reschedule_Alarm:", strlen("Reschedule_Alarm:")) == 0)
+	{
+		if(sscanf(line, "Reschedule_Alarm: %lu %d %1s", alarm_id, &seconds, cmd) == 2)
+		{
+			if(seconds < 0){
+				fprintf (stderr, "Alarm delay must not be negative.\n");
+				ret_value = -1;
+			}else
+			{
+				*alarm_second = seconds;
+				ret_value = 4;
+			}
+		}else
+		{
+			fprintf (stderr, "The number of parameters is not correct.\n");
+			ret_value = -1;
+		}
+	}else if(strncmp(line, "Stats:", strlen("Stats:")) == 0)
+	{
+		switch(sscanf(line, "Stats: %19s %1s", str_msg_type, cmd))
+		{
+		case EOF:
+		case 0:
+			ret_value = 5;
+			break;
+		case 1:
+			if(strcmp(str_msg_type, "Threads") == 0)
+			{
+				ret_value = 6;
+				break;
+			}
+			if(strcmp(str_msg_type, "Memory") == 0)
+			{
+				ret_value = 8;
+				break;
+			}
+			/* fall through */
+		default:
+			fprintf (stderr, "Unknown statistics; use \"Stats:\", \"Stats: Threads\" or \"Stats: Memory\".\n");
+			ret_value = -1;
+		}
+	}else if(strncmp(line, "Barrier:", strlen("Barrier:")) == 0)
+	{
+		if(sscanf(line, "Barrier: %1s", cmd) == 1)
+		{
+			fprintf (stderr, "Barrier: takes no parameters.\n");
+			ret_value = -1;
+		}else
+		{
+			ret_value = 7;
+		}
+	}else if(sscanf(line, "%d %255s %128[^\n]", alarm_second, str_msg_type, message) == 3)
+	{
+		ret_value = 3;
+		sscanf(str_msg_type,"%*[^0123456789]%d",msg_type);
+
+	}else if(sscanf(line, "%19s %255s",cmd, str_msg_type) == 2)
+	{
+		if(sscanf(str_msg_type, "%*[^0123456789]%d", msg_type) == 1 &&
+				strncmp(str_msg_type,"MessageType(",strlen("MessageType(") - 1 ) == 0){
+			if(*msg_type < 1){
+				fprintf (stderr, "Message type must be the positive integer.\n");
+				ret_value = -1;
+			}else if(strcmp(cmd,"Create_Thread:")==0){
+				ret_value = 1;
+			}else if(strcmp(cmd,"Terminate_Thread:") == 0){
+				ret_value = 2;
+			}else
+			{
+				ret_value = -1;
+			}
+		}else
+		{
+			ret_value = -1;
+		}
+	}else
+	{
+		fprintf (stderr, "The number of parameters is not correct.\n");
+		ret_value = -1;
+	}
+
+	return ret_value;
+}
+
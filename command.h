@@ -0,0 +1,24 @@
+/*
+ * command.h
+ * The commands main reads from its input, and their parser.
+ */
+#ifndef __command_h
+#define __command_h
+
+/*
+ * get_cmd_type writes at most this many characters of message, plus
+ * the terminating null.
+ */
+#define CMD_MESSAGE_MAX     128
+
+/*
+ * A token can be as long as the longest line main reads, so
+ * get_cmd_type reads the message type token into this many
+ * characters, plus the terminating null.
+ */
+#define CMD_TOKEN_MAX       255
+
+int get_cmd_type(char* line, unsigned int* msg_type, unsigned int* alarm_second, char* message,
+		unsigned long* alarm_id);
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * dedup.c
+ * Time-windowed duplicate set; see dedup.h.
+ */
+#include "dedup.h"
+#include "errors.h"
+
+/*
+ * 64-bit FNV-1a over the fields that make two requests identical.
+ */
+static unsigned long dedup_hash (unsigned int seconds, unsigned int type,
+	const char *message)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned int words[2];
+	const unsigned char *p;
+	size_t i;
+
+	words[0] = seconds;
+	words[1] = type;
+	p = (const unsigned char *)words;
+	for (i = 0; i < sizeof (words); i++)
+		hash = (hash ^ p[i]) * 1099511628211ULL;
+	for (p = (const unsigned char *)message; *p != '\0'; p++)
+		hash = (hash ^ *p) * 1099511628211ULL;
+	return (unsigned long)hash;
+}
+
+/*
+ * Set up a set remembering up to capacity requests for window
+ * seconds. A window of 0 leaves the set disabled.
+ */
+int dedup_init (dedup_t *set, time_t window, long capacity)
+{
+	unsigned long buckets = 1;
+
+	memset (set, 0, sizeof (*set));
+	set->window = window;
+	if (window <= 0)
+		return 0;
+	while (buckets < (unsigned long)capacity * 2)
+		buckets <<= 1;
+	set->ring = calloc (capacity, sizeof (*set->ring));
+	set->buckets = calloc (buckets, sizeof (*set->buckets));
+	if (set->ring == NULL || set->buckets == NULL)
+		return ENOMEM;
+	set->capacity = capacity;
+	set->mask = buckets - 1;
+	return 0;
+}
+
+/*
+ * Drop the oldest entry from the ring and its bucket.
+ */
+static void dedup_expire_oldest (dedup_t *set)
+{
+	dedup_entry_t *entry = &set->ring[set->oldest];
+	dedup_entry_t **last = &set->buckets[entry->hash & set->mask];
+
+	while (*last != entry)
+		last = &(*last)->next;
+	*last = entry->next;
+	set->oldest = (set->oldest + 1) % set->capacity;
+	set->count--;
+}
+
+/*
+ * Returns 1 if an identical request was accepted within the window,
+ * in which case the caller should drop this one. Otherwise records
+ * the request as accepted at now and returns 0.
+ */
+int dedup_check (dedup_t *set, unsigned int seconds, unsigned int type,
+	const char *message, time_t now)
+{
+	dedup_entry_t *entry;
+	unsigned long hash;
+
+	if (set->window <= 0)
+		return 0;
+	while (set->count > 0 && set->ring[set->oldest].seen + set->window <= now)
+		dedup_expire_oldest (set);
+
+	hash = dedup_hash (seconds, type, message);
+	for (entry = set->buckets[hash & set->mask]; entry != NULL; entry = entry->next)
+		if (entry->hash == hash && entry->seconds == seconds && entry->type == type
+				&& strcmp (entry->message, message) == 0)
+			return 1;
+
+	if (set->count == set->capacity)
+		dedup_expire_oldest (set);
+	entry = &set->ring[(set->oldest + set->count) % set->capacity];
+	entry->hash = hash;
+	entry->seen = now;
+	entry->seconds = seconds;
+	entry->type = type;
+	strncpy (entry->message, message, DEDUP_MESSAGE_SIZE - 1);
+	entry->message[DEDUP_MESSAGE_SIZE - 1] = '\0';
+	entry->next = set->buckets[hash & set->mask];
+	set->buckets[hash & set->mask] = entry;
+	set->count++;
+	return 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * dedup.h
+ * Duplicate alarm suppression. Upstream retries tend to submit the
+ * same alarm (same seconds, type and message) several times within a
+ * few seconds. With a2 -d <window>, main checks each alarm request
+ * here before alarm_insert and drops it if an identical request was
+ * accepted less than <window> seconds earlier.
+ *
+ * The set remembers accepted requests in arrival order in a ring of
+ * fixed capacity and hashes them into buckets for lookup. Entries
+ * leave the set when their window has passed, or early if more than
+ * the capacity arrive within one window. Nothing is allocated after
+ * dedup_init. Only main uses the set, so it has no lock.
+ */
+#ifndef __dedup_h
+#define __dedup_h
+
+#include <time.h>
+#include "command.h"
+
+#define DEDUP_MESSAGE_SIZE  (CMD_MESSAGE_MAX + 1)
+
+typedef struct dedup_entry_tag {
+	struct dedup_entry_tag  *next;      /* bucket chain */
+	unsigned long           hash;
+	time_t                  seen;       /* when the request was accepted */
+	unsigned int            seconds;
+	unsigned int            type;
+	char                    message[DEDUP_MESSAGE_SIZE];
+} dedup_entry_t;
+
+typedef struct dedup_tag {
+	time_t                  window;     /* 0 disables suppression */
+	dedup_entry_t           *ring;
+	long                    capacity;
+	long                    oldest;     /* ring slot of the oldest entry */
+	long                    count;
+	dedup_entry_t           **buckets;
+	unsigned long           mask;       /* bucket count - 1 */
+} dedup_t;
+
+int dedup_init (dedup_t *set, time_t window, long capacity);
+int dedup_check (dedup_t *set, unsigned int seconds, unsigned int type,
+	const char *message, time_t now);
+
+#endif
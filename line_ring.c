@@ -0,0 +1,145 @@
+/*
+ * line_ring.c
+ * The stdin read-ahead ring; see line_ring.h.
+ */
+#include "line_ring.h"
+#include "errors.h"
+#include "cmd_scan.h"
+#include "stats.h"
+
+/*
+ * Copy the len bytes at text into the ring as one line, waiting while
+ * it is full, or with more zero mark the end of input.
+ */
+static void line_ring_put (line_ring_t *ring, const char *text, long len, int more)
+{
+	char *slot;
+	int status;
+
+	status = pthread_mutex_lock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Lock ring mutex");
+	if (more) {
+		if (ring->count == ring->depth)
+			STATS_ADD (reader_stalls, 1);
+		while (ring->count == ring->depth) {
+			status = pthread_cond_wait (&ring->not_full, &ring->mutex);
+			if (status != 0)
+				err_abort (status, "Wait for ring space");
+		}
+		slot = ring->lines[(ring->head + ring->count) % ring->depth];
+		memcpy (slot, text, len);
+		slot[len] = '\0';
+		ring->count++;
+	} else
+		ring->eof = 1;
+	status = pthread_cond_signal (&ring->not_empty);
+	if (status != 0)
+		err_abort (status, "Signal ring");
+	status = pthread_mutex_unlock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock ring mutex");
+}
+
+/*
+ * The reader thread's start routine. Input is read a block at a time
+ * and split with cmd_scan_line into the same pieces fgets into a
+ * LINE_RING_LINE buffer would return: up to and including a newline,
+ * but never more than LINE_RING_LINE - 1 characters.
+ */
+static void *line_ring_reader (void *arg)
+{
+	line_ring_t *ring = (line_ring_t *)arg;
+	long start = 0, end = 0, len;
+	ssize_t got;
+	int eof = 0;
+
+	while (1) {
+		len = cmd_scan_line (ring->block + start, end - start);
+		if (len < end - start)
+			len++;
+		if (len >= LINE_RING_LINE)
+			len = LINE_RING_LINE - 1;
+		if ((len > 0 && ring->block[start + len - 1] == '\n')
+				|| len == LINE_RING_LINE - 1 || (eof && len > 0)) {
+			line_ring_put (ring, ring->block + start, len, 1);
+			start += len;
+			continue;
+		}
+		if (eof)
+			break;
+		memmove (ring->block, ring->block + start, end - start);
+		end -= start;
+		start = 0;
+		got = read (fileno (ring->in), ring->block + end, LINE_RING_BLOCK - end);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			eof = 1;
+		else
+			end += got;
+	}
+	line_ring_put (ring, NULL, 0, 0);
+	return NULL;
+}
+
+/*
+ * Allocate a ring of depth lines and start reading in into it.
+ */
+int line_ring_start (line_ring_t *ring, FILE *in, long depth)
+{
+	int status;
+
+	memset (ring, 0, sizeof (*ring));
+	ring->lines = calloc (depth, sizeof (*ring->lines));
+	ring->block = malloc (LINE_RING_BLOCK);
+	if (ring->lines == NULL || ring->block == NULL)
+		return ENOMEM;
+	ring->depth = depth;
+	ring->in = in;
+	status = pthread_mutex_init (&ring->mutex, NULL);
+	if (status == 0)
+		status = pthread_cond_init (&ring->not_empty, NULL);
+	if (status == 0)
+		status = pthread_cond_init (&ring->not_full, NULL);
+	if (status == 0)
+		status = pthread_create (&ring->reader, NULL, line_ring_reader, ring);
+	return status;
+}
+
+/*
+ * Give back the line the previous call returned and take the next
+ * one, waiting for the reader if need be. The line is used where it
+ * lies in the ring rather than copied out. Returns NULL once input
+ * has ended and the ring is empty.
+ */
+char *line_ring_get (line_ring_t *ring)
+{
+	char *result = NULL;
+	int status;
+
+	status = pthread_mutex_lock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Lock ring mutex");
+	if (ring->held) {
+		ring->held = 0;
+		ring->head = (ring->head + 1) % ring->depth;
+		ring->count--;
+		status = pthread_cond_signal (&ring->not_full);
+		if (status != 0)
+			err_abort (status, "Signal ring");
+	}
+	while (ring->count == 0 && !ring->eof) {
+		status = pthread_cond_wait (&ring->not_empty, &ring->mutex);
+		if (status != 0)
+			err_abort (status, "Wait for ring line");
+	}
+	if (ring->count > 0) {
+		ring->held = 1;
+		result = ring->lines[ring->head];
+	}
+	status = pthread_mutex_unlock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock ring mutex");
+	return result;
+}
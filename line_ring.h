@@ -0,0 +1,38 @@
+/*
+ * line_ring.h
+ * Read-ahead for main's command input. With a2 -r <depth> a reader
+ * thread copies stdin into a bounded ring of lines while main
+ * processes earlier ones, so main waiting on print_mutex or
+ * alarm_mutex does not stop stdin being drained. When the ring is
+ * full the reader waits and counts a stall (see "Stats:"). The
+ * reader owns the input file descriptor and reads it in blocks, so
+ * nothing else may read from in once the ring is started.
+ */
+#ifndef __line_ring_h
+#define __line_ring_h
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define LINE_RING_LINE  256
+#define LINE_RING_BLOCK 65536       /* bytes the reader asks read() for at once */
+
+typedef struct line_ring_tag {
+	pthread_mutex_t     mutex;
+	pthread_cond_t      not_empty;
+	pthread_cond_t      not_full;
+	char                (*lines)[LINE_RING_LINE];
+	long                depth;
+	long                head;       /* next line to take */
+	long                count;      /* lines waiting, and the one main holds */
+	int                 held;       /* main is still using the line at head */
+	int                 eof;        /* the reader has seen end of input */
+	FILE                *in;
+	char                *block;     /* input read but not yet split into lines */
+	pthread_t           reader;
+} line_ring_t;
+
+int line_ring_start (line_ring_t *ring, FILE *in, long depth);
+char *line_ring_get (line_ring_t *ring);
+
+#endif
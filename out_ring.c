@@ -0,0 +1,264 @@
+/*
+ * out_ring.c
+ * The bounded stdout ring; see out_ring.h.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include "out_ring.h"
+#include "errors.h"
+#include "stats.h"
+
+static long newlines (const char *text, size_t len)
+{
+	long lines = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		lines += text[i] == '\n';
+	return lines;
+}
+
+/*
+ * Write all of text to fd, however many calls it takes.
+ */
+static void write_all (int fd, const char *text, size_t len)
+{
+	ssize_t done;
+
+	while (len > 0) {
+		done = write (fd, text, len);
+		if (done < 0 && errno == EINTR)
+			continue;
+		if (done <= 0)
+			return;
+		text += done;
+		len -= done;
+	}
+}
+
+/*
+ * Drop lines from the front of the ring until len more bytes fit,
+ * finishing the line the last byte needed came from. Returns the
+ * number of lines dropped. Requires ring->mutex.
+ */
+static long out_ring_drop_oldest (out_ring_t *ring, size_t len)
+{
+	long lines = 0;
+	char c = '\n';
+
+	while (ring->count > 0 && (ring->size - ring->count < len || c != '\n')) {
+		c = ring->buf[ring->head];
+		ring->head = (ring->head + 1) % ring->size;
+		ring->count--;
+		lines += c == '\n';
+	}
+	return lines;
+}
+
+/*
+ * The stream's write function, called with the stream locked, so by
+ * one printing thread at a time. It returns at once unless the policy
+ * is block and the ring is full. Output that does not fit is dropped
+ * or spilled but still reported as written, so stdio does not retry it.
+ */
+static ssize_t out_ring_write (void *cookie, const char *text, size_t size)
+{
+	out_ring_t *ring = (out_ring_t *)cookie;
+	size_t len = size, tail, first;
+	int status;
+
+	if (len > ring->size / 2) {
+		out_ring_write (cookie, text, ring->size / 2);
+		out_ring_write (cookie, text + ring->size / 2, len - ring->size / 2);
+		return (ssize_t)size;
+	}
+	status = pthread_mutex_lock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Lock output ring");
+	if (!ring->closed && len > ring->size - ring->count) {
+		switch (ring->policy) {
+		case OUT_BLOCK:
+			STATS_ADD (out_waits, 1);
+			while (!ring->closed && len > ring->size - ring->count) {
+				status = pthread_cond_wait (&ring->not_full, &ring->mutex);
+				if (status != 0)
+					err_abort (status, "Wait for output ring space");
+			}
+			break;
+		case OUT_DROP_OLDEST:
+			STATS_ADD (out_dropped, out_ring_drop_oldest (ring, len));
+			break;
+		case OUT_DROP_NEW:
+			STATS_ADD (out_dropped, newlines (text, len));
+			len = 0;
+			break;
+		case OUT_SPILL:
+			write_all (ring->spill, text, len);
+			STATS_ADD (out_spilled, newlines (text, len));
+			len = 0;
+			break;
+		}
+	}
+	/*
+	 *Once the writer has stopped, at exit, output goes straight out
+	 */
+	if (ring->closed) {
+		write_all (ring->fd, text, len);
+		len = 0;
+	}
+	if (len > 0) {
+		tail = (ring->head + ring->count) % ring->size;
+		first = ring->size - tail < len ? ring->size - tail : len;
+		memcpy (ring->buf + tail, text, first);
+		memcpy (ring->buf, text + first, len - first);
+		ring->count += len;
+		status = pthread_cond_signal (&ring->not_empty);
+		if (status != 0)
+			err_abort (status, "Signal output ring");
+	}
+	status = pthread_mutex_unlock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock output ring");
+	return (ssize_t)size;
+}
+
+/*
+ * The writer thread's start routine. It takes up to PIPE_BUF bytes at
+ * a time, ending at the last newline among them when there is one, so
+ * the ring normally starts at a line and drop-oldest drops whole
+ * lines. Only this thread ever waits for the real output.
+ */
+static void *out_ring_writer (void *arg)
+{
+	out_ring_t *ring = (out_ring_t *)arg;
+	char chunk[PIPE_BUF];
+	size_t len, end, i;
+	int status;
+
+	status = pthread_mutex_lock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Lock output ring");
+	while (1) {
+		while (ring->count == 0 && !ring->closing) {
+			status = pthread_cond_wait (&ring->not_empty, &ring->mutex);
+			if (status != 0)
+				err_abort (status, "Wait for output");
+		}
+		if (ring->count == 0)
+			break;
+		len = ring->count < PIPE_BUF ? ring->count : PIPE_BUF;
+		for (i = 0, end = 0; i < len; i++) {
+			chunk[i] = ring->buf[(ring->head + i) % ring->size];
+			if (chunk[i] == '\n')
+				end = i + 1;
+		}
+		if (end == 0)
+			end = len;
+		ring->head = (ring->head + end) % ring->size;
+		ring->count -= end;
+		status = pthread_cond_broadcast (&ring->not_full);
+		if (status != 0)
+			err_abort (status, "Broadcast output ring");
+		status = pthread_mutex_unlock (&ring->mutex);
+		if (status != 0)
+			err_abort (status, "Unlock output ring");
+		write_all (ring->fd, chunk, end);
+		status = pthread_mutex_lock (&ring->mutex);
+		if (status != 0)
+			err_abort (status, "Lock output ring");
+	}
+	ring->closed = 1;
+	status = pthread_cond_broadcast (&ring->not_full);
+	if (status != 0)
+		err_abort (status, "Broadcast output ring");
+	status = pthread_mutex_unlock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock output ring");
+	return NULL;
+}
+
+/*
+ * Parse "block", "drop-oldest", "drop-new" or "spill:FILE"; *spill
+ * points at FILE in text. Returns 0, or -1 if text is none of them.
+ */
+int out_policy_parse (const char *text, out_policy_t *policy, const char **spill)
+{
+	*spill = NULL;
+	if (strcmp (text, "block") == 0)
+		*policy = OUT_BLOCK;
+	else if (strcmp (text, "drop-oldest") == 0)
+		*policy = OUT_DROP_OLDEST;
+	else if (strcmp (text, "drop-new") == 0)
+		*policy = OUT_DROP_NEW;
+	else if (strncmp (text, "spill:", 6) == 0 && text[6] != '\0') {
+		*policy = OUT_SPILL;
+		*spill = text + 6;
+	} else
+		return -1;
+	return 0;
+}
+
+/*
+ * Allocate a ring of size bytes draining into fd, open the spill file
+ * if the policy has one, start the writer and return the stream that
+ * writes into the ring in *stream. Returns 0 or an errno value.
+ */
+int out_ring_start (out_ring_t *ring, int fd, size_t size, out_policy_t policy,
+	const char *spill, FILE **stream)
+{
+	cookie_io_functions_t functions = { NULL, out_ring_write, NULL, NULL };
+	int status;
+
+	memset (ring, 0, sizeof (*ring));
+	ring->buf = malloc (size);
+	if (ring->buf == NULL)
+		return ENOMEM;
+	ring->size = size;
+	ring->policy = policy;
+	ring->fd = fd;
+	ring->spill = -1;
+	if (spill != NULL) {
+		ring->spill = open (spill, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (ring->spill < 0)
+			return errno;
+	}
+	*stream = fopencookie (ring, "w", functions);
+	if (*stream == NULL)
+		return errno != 0 ? errno : ENOMEM;
+	status = pthread_mutex_init (&ring->mutex, NULL);
+	if (status == 0)
+		status = pthread_cond_init (&ring->not_empty, NULL);
+	if (status == 0)
+		status = pthread_cond_init (&ring->not_full, NULL);
+	if (status == 0)
+		status = pthread_create (&ring->writer, NULL, out_ring_writer, ring);
+	return status;
+}
+
+/*
+ * Wait for the writer to write out what the ring holds, and stop it;
+ * later output is written directly. The caller flushes the stream
+ * first. Under a drop or spill policy the wait is still as long as the
+ * reader takes to make room for what is left.
+ */
+void out_ring_stop (out_ring_t *ring)
+{
+	int status;
+
+	status = pthread_mutex_lock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Lock output ring");
+	ring->closing = 1;
+	status = pthread_cond_signal (&ring->not_empty);
+	if (status != 0)
+		err_abort (status, "Signal output ring");
+	while (!ring->closed) {
+		status = pthread_cond_wait (&ring->not_full, &ring->mutex);
+		if (status != 0)
+			err_abort (status, "Wait for output ring");
+	}
+	status = pthread_mutex_unlock (&ring->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock output ring");
+}
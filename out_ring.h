@@ -0,0 +1,55 @@
+/*
+ * out_ring.h
+ * Bounded output that does not wait for the reader. With a2 -o
+ * <policy>, stdout becomes a stream whose writes only copy into a ring
+ * of -b bytes, and a writer thread drains the ring into the real
+ * standard output. A thread printing under print_mutex then waits for
+ * whoever reads a2's output only if the policy says so. When the ring
+ * is full:
+ *
+ *   block        the printing thread waits for room, as without -o
+ *   drop-oldest  the oldest lines not yet written make room
+ *   drop-new     the new output is dropped
+ *   spill:FILE   the new output is appended to FILE instead
+ *
+ * The writer takes whole lines out of the ring where it can, so lines
+ * are dropped or spilled whole. Dropped and spilled lines, and writes
+ * that had to wait, are counted in "Stats:".
+ */
+#ifndef __out_ring_h
+#define __out_ring_h
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define OUT_RING_MIN    16384       /* twice what stdio hands over at once */
+
+typedef enum out_policy_tag {
+	OUT_BLOCK,
+	OUT_DROP_OLDEST,
+	OUT_DROP_NEW,
+	OUT_SPILL
+} out_policy_t;
+
+typedef struct out_ring_tag {
+	pthread_mutex_t     mutex;
+	pthread_cond_t      not_empty;
+	pthread_cond_t      not_full;   /* also: the writer has stopped */
+	char                *buf;
+	size_t              size;
+	size_t              head;       /* next byte to write */
+	size_t              count;      /* bytes waiting */
+	int                 closing;    /* drain and stop */
+	int                 closed;     /* the writer has stopped */
+	out_policy_t        policy;
+	int                 fd;         /* the real output */
+	int                 spill;      /* OUT_SPILL: the file overflow goes to */
+	pthread_t           writer;
+} out_ring_t;
+
+int out_policy_parse (const char *text, out_policy_t *policy, const char **spill);
+int out_ring_start (out_ring_t *ring, int fd, size_t size, out_policy_t policy,
+	const char *spill, FILE **stream);
+void out_ring_stop (out_ring_t *ring);
+
+#endif
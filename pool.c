@@ -0,0 +1,134 @@
+/*
+ * pool.c
+ * Fixed-size object pool; see pool.h.
+ */
+#include "pool.h"
+#include "errors.h"
+
+/*
+ * Carve count more objects onto the free list. Called with the pool
+ * mutex held. Returns 0 or ENOMEM.
+ */
+static int pool_grow (pool_t *pool, long count)
+{
+	size_t size = pool->size < sizeof (void *) ? sizeof (void *) : pool->size;
+	char *chunk;
+	long i;
+
+	chunk = malloc (size * count);
+	if (chunk == NULL)
+		return ENOMEM;
+	for (i = 0; i < count; i++) {
+		*(void **)(chunk + i * size) = pool->free_list;
+		pool->free_list = chunk + i * size;
+	}
+	pool->free_count += count;
+	pool->total += count;
+	return 0;
+}
+
+/*
+ * Make sure at least count objects have been carved, so the pool
+ * does not need to grow until more than that are in use at once.
+ */
+int pool_reserve (pool_t *pool, long count)
+{
+	int status, grow_status = 0;
+
+	status = pthread_mutex_lock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Lock pool mutex");
+	if (pool->total < count)
+		grow_status = pool_grow (pool, count - pool->total);
+	status = pthread_mutex_unlock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock pool mutex");
+	return grow_status;
+}
+
+/*
+ * Take an object from the pool, growing it by one chunk if it is
+ * empty. Returns NULL only if that growth fails.
+ */
+void *pool_get (pool_t *pool)
+{
+	void *object = NULL;
+	int status;
+
+	status = pthread_mutex_lock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Lock pool mutex");
+	if (pool->free_list != NULL || pool_grow (pool, pool->chunk) == 0) {
+		object = pool->free_list;
+		pool->free_list = *(void **)object;
+		pool->free_count--;
+	}
+	status = pthread_mutex_unlock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock pool mutex");
+	return object;
+}
+
+void pool_put (pool_t *pool, void *object)
+{
+	int status;
+
+	status = pthread_mutex_lock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Lock pool mutex");
+	*(void **)object = pool->free_list;
+	pool->free_list = object;
+	pool->free_count++;
+	if (pool->waiters > 0) {
+		status = pthread_cond_broadcast (&pool->returned);
+		if (status != 0)
+			err_abort (status, "Broadcast pool");
+	}
+	status = pthread_mutex_unlock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock pool mutex");
+}
+
+/*
+ * Wait until no more than in_use objects are out of the pool, and
+ * return how many are. Puts only signal while someone waits.
+ */
+long pool_wait (pool_t *pool, long in_use)
+{
+	long out;
+	int status;
+
+	status = pthread_mutex_lock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Lock pool mutex");
+	pool->waiters++;
+	while (pool->total - pool->free_count > in_use) {
+		status = pthread_cond_wait (&pool->returned, &pool->mutex);
+		if (status != 0)
+			err_abort (status, "Wait for pool");
+	}
+	pool->waiters--;
+	out = pool->total - pool->free_count;
+	status = pthread_mutex_unlock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock pool mutex");
+	return out;
+}
+
+/*
+ * How many objects sit unused on the free list.
+ */
+long pool_free (pool_t *pool)
+{
+	long count;
+	int status;
+
+	status = pthread_mutex_lock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Lock pool mutex");
+	count = pool->free_count;
+	status = pthread_mutex_unlock (&pool->mutex);
+	if (status != 0)
+		err_abort (status, "Unlock pool mutex");
+	return count;
+}
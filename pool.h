@@ -0,0 +1,37 @@
+/*
+ * pool.h
+ * Fixed-size object pool. Objects are carved from chunks that are
+ * never returned to malloc, and released objects go back on a free
+ * list, so once the pool has grown to the working set, getting and
+ * putting objects never touches the heap. a2 keeps its alarms here
+ * and can size the pool up front with -p. pool_wait lets a thread wait
+ * for objects to come back, which is how a2 drains its alarms.
+ */
+#ifndef __pool_h
+#define __pool_h
+
+#include <pthread.h>
+#include <stddef.h>
+
+typedef struct pool_tag {
+	pthread_mutex_t     mutex;
+	size_t              size;       /* object size */
+	long                chunk;      /* objects added when the pool runs dry */
+	void                *free_list;
+	long                free_count;
+	long                total;      /* objects carved so far */
+	pthread_cond_t      returned;   /* an object was put back */
+	long                waiters;    /* threads in pool_wait */
+} pool_t;
+
+#define POOL_INITIALIZER(type, chunk) \
+	{ PTHREAD_MUTEX_INITIALIZER, sizeof (type), (chunk), NULL, 0, 0, \
+	PTHREAD_COND_INITIALIZER, 0 }
+
+int pool_reserve (pool_t *pool, long count);
+void *pool_get (pool_t *pool);
+void pool_put (pool_t *pool, void *object);
+long pool_wait (pool_t *pool, long in_use);
+long pool_free (pool_t *pool);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * reorder.c
+ * The fired-alarm reorder buffer; see reorder.h.
+ */
+#include <stdarg.h>
+#include "reorder.h"
+#include "errors.h"
+#include "stats.h"
+
+static int before (const reorder_entry_t *a, const reorder_entry_t *b)
+{
+	return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+/*
+ * Set up a buffer for capacity fired alarms, each held until the clock
+ * is window seconds past its deadline. A window of 0 leaves it
+ * disabled.
+ */
+int reorder_init (reorder_t *order, time_t window, long capacity)
+{
+	long i;
+
+	memset (order, 0, sizeof (*order));
+	order->window = window;
+	if (window <= 0)
+		return 0;
+	order->entries = calloc (capacity, sizeof (*order->entries));
+	order->heap = calloc (capacity, sizeof (*order->heap));
+	order->free = calloc (capacity, sizeof (*order->free));
+	if (order->entries == NULL || order->heap == NULL || order->free == NULL)
+		return ENOMEM;
+	for (i = 0; i < capacity; i++)
+		order->free[i] = &order->entries[i];
+	order->free_count = capacity;
+	return 0;
+}
+
+/*
+ * An entry to fill in and push, or NULL when the buffer is full and
+ * one has to be popped first.
+ */
+reorder_entry_t *reorder_slot (reorder_t *order)
+{
+	if (order->free_count == 0)
+		return NULL;
+	return order->free[--order->free_count];
+}
+
+/*
+ * Format a line onto the len bytes of entry's text already filled in
+ * and return the new length. REORDER_TEXT has room for the widest
+ * lines; should they ever not fit, the text is cut but still ends in
+ * a newline.
+ */
+int reorder_append (reorder_entry_t *entry, int len, const char *format, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start (ap, format);
+	n = vsnprintf (entry->text + len, REORDER_TEXT - len, format, ap);
+	va_end (ap);
+	if (n < 0) {
+		entry->text[len] = '\0';
+		return len;
+	}
+	if (n >= REORDER_TEXT - len) {
+		entry->text[REORDER_TEXT - 2] = '\n';
+		return REORDER_TEXT - 1;
+	}
+	return len + n;
+}
+
+void reorder_push (reorder_t *order, reorder_entry_t *entry)
+{
+	long i = order->count++, parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!before (entry, order->heap[parent]))
+			break;
+		order->heap[i] = order->heap[parent];
+		i = parent;
+	}
+	order->heap[i] = entry;
+}
+
+/*
+ * Take the earliest entry if the clock is window seconds past its
+ * deadline, or with all set in any case; NULL if there is none to
+ * take. An entry that sorts before the one taken last is counted as
+ * out of order.
+ */
+reorder_entry_t *reorder_pop (reorder_t *order, time_t now, int all)
+{
+	reorder_entry_t *top, *last;
+	long i = 0, child;
+
+	if (order->count == 0)
+		return NULL;
+	top = order->heap[0];
+	if (!all && top->time + order->window > now)
+		return NULL;
+	last = order->heap[--order->count];
+	while ((child = 2 * i + 1) < order->count) {
+		if (child + 1 < order->count && before (order->heap[child + 1], order->heap[child]))
+			child++;
+		if (!before (order->heap[child], last))
+			break;
+		order->heap[i] = order->heap[child];
+		i = child;
+	}
+	order->heap[i] = last;
+
+	if (top->time < order->last_time
+			|| (top->time == order->last_time && top->seq < order->last_seq))
+		STATS_ADD (unordered, 1);
+	else {
+		order->last_time = top->time;
+		order->last_seq = top->seq;
+	}
+	return top;
+}
+
+void reorder_release (reorder_t *order, reorder_entry_t *entry)
+{
+	order->free[order->free_count++] = entry;
+}
@@ -0,0 +1,51 @@
+/*
+ * reorder.h
+ * Ordered output of fired alarms. With a2 -O <window>, the lines an
+ * alarm thread prints when an alarm fires are not written at once but
+ * kept here under the key (deadline, alarm id). The order thread
+ * writes them out in key order once the alarm clock is window seconds
+ * past their deadline, so alarms due in the same second come out in
+ * the order they were accepted, whichever thread fired them first.
+ *
+ * The buffer holds at most REORDER_CAPACITY fired alarms; when it is
+ * full the earliest is written early to make room. An alarm fired
+ * after a later key has been written cannot be put back in order and
+ * is counted in "Stats:" as out of order. Entries are allocated once,
+ * by reorder_init. Everything here is guarded by print_mutex.
+ */
+#ifndef __reorder_h
+#define __reorder_h
+
+#include <time.h>
+#include "command.h"
+
+#define REORDER_CAPACITY    4096
+#define REORDER_LINE        128     /* an Assigned or Printed line, widest numbers */
+#define REORDER_TEXT        (2 * REORDER_LINE + CMD_MESSAGE_MAX + 16)
+                                    /* the lines of one fired alarm */
+
+typedef struct reorder_entry_tag {
+	time_t              time;       /* deadline */
+	unsigned long       seq;        /* alarm id */
+	char                text[REORDER_TEXT];
+} reorder_entry_t;
+
+typedef struct reorder_tag {
+	time_t              window;     /* 0 disables ordering */
+	reorder_entry_t     *entries;
+	reorder_entry_t     **heap;     /* min-heap on (time, seq) */
+	long                count;
+	reorder_entry_t     **free;
+	long                free_count;
+	time_t              last_time;  /* key of the last entry written */
+	unsigned long       last_seq;
+} reorder_t;
+
+int reorder_init (reorder_t *order, time_t window, long capacity);
+reorder_entry_t *reorder_slot (reorder_t *order);
+int reorder_append (reorder_entry_t *entry, int len, const char *format, ...);
+void reorder_push (reorder_t *order, reorder_entry_t *entry);
+reorder_entry_t *reorder_pop (reorder_t *order, time_t now, int all);
+void reorder_release (reorder_t *order, reorder_entry_t *entry);
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * sched_lock.c
+ * Mutex, ticket and MCS flavours of the scheduler lock; see
+ * sched_lock.h.
+ */
+#include <sched.h>
+#include <string.h>
+#include "sched_lock.h"
+
+static const char *kind_names[SCHED_LOCK_NKINDS] = {
+	"mutex", "ticket", "mcs"
+};
+
+static __thread sched_lock_node_t self;
+
+/*
+ * Back off while spinning. A waiter that spins for long is most
+ * likely behind a holder that has been preempted, so after a short
+ * busy wait it gives up the CPU on every round instead.
+ */
+static void spin_pause (int *spins)
+{
+	if (++*spins < 64) {
+#if defined (__x86_64__) || defined (__i386__)
+		__builtin_ia32_pause ();
+#endif
+	} else
+		sched_yield ();
+}
+
+static void ticket_lock (sched_lock_t *lock)
+{
+	unsigned long ticket;
+	int spins = 0;
+
+	ticket = __atomic_fetch_add (&lock->next_ticket, 1, __ATOMIC_RELAXED);
+	while (__atomic_load_n (&lock->now_serving, __ATOMIC_ACQUIRE) != ticket)
+		spin_pause (&spins);
+}
+
+static void ticket_unlock (sched_lock_t *lock)
+{
+	__atomic_store_n (&lock->now_serving, lock->now_serving + 1, __ATOMIC_RELEASE);
+}
+
+static void mcs_lock (sched_lock_t *lock)
+{
+	sched_lock_node_t *pred;
+	int spins = 0;
+
+	self.next = NULL;
+	self.locked = 1;
+	pred = __atomic_exchange_n (&lock->tail, &self, __ATOMIC_ACQ_REL);
+	if (pred == NULL)
+		return;
+	__atomic_store_n (&pred->next, &self, __ATOMIC_RELEASE);
+	while (__atomic_load_n (&self.locked, __ATOMIC_ACQUIRE))
+		spin_pause (&spins);
+}
+
+static void mcs_unlock (sched_lock_t *lock)
+{
+	sched_lock_node_t *next, *expected = &self;
+	int spins = 0;
+
+	next = __atomic_load_n (&self.next, __ATOMIC_ACQUIRE);
+	if (next == NULL) {
+		if (__atomic_compare_exchange_n (&lock->tail, &expected, NULL, 0,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return;
+		/*
+		 * A waiter has swapped itself in as the tail but not yet
+		 * linked itself behind us.
+		 */
+		while ((next = __atomic_load_n (&self.next, __ATOMIC_ACQUIRE)) == NULL)
+			spin_pause (&spins);
+	}
+	__atomic_store_n (&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+int sched_lock_lock (sched_lock_t *lock)
+{
+	switch (lock->kind) {
+	case SCHED_LOCK_TICKET:
+		ticket_lock (lock);
+		return 0;
+	case SCHED_LOCK_MCS:
+		mcs_lock (lock);
+		return 0;
+	default:
+		return pthread_mutex_lock (&lock->mutex);
+	}
+}
+
+int sched_lock_unlock (sched_lock_t *lock)
+{
+	switch (lock->kind) {
+	case SCHED_LOCK_TICKET:
+		ticket_unlock (lock);
+		return 0;
+	case SCHED_LOCK_MCS:
+		mcs_unlock (lock);
+		return 0;
+	default:
+		return pthread_mutex_unlock (&lock->mutex);
+	}
+}
+
+/*
+ * Cleanup for a waiter cancelled inside pthread_cond_wait: the
+ * caller's own cleanup expects the scheduler lock to be held, as it
+ * would be after pthread_cond_wait on a mutex.
+ */
+static void wait_cleanup (void *arg)
+{
+	sched_lock_t *lock = (sched_lock_t *)arg;
+
+	pthread_mutex_unlock (&lock->wait_mutex);
+	sched_lock_lock (lock);
+}
+
+/*
+ * Release the lock, wait on cond and take the lock again. Like
+ * pthread_cond_wait this is a cancellation point, and wakeups may
+ * be spurious.
+ */
+int sched_lock_wait (sched_lock_t *lock, pthread_cond_t *cond)
+{
+	int status;
+
+	if (lock->kind == SCHED_LOCK_MUTEX)
+		return pthread_cond_wait (cond, &lock->mutex);
+	status = pthread_mutex_lock (&lock->wait_mutex);
+	if (status != 0)
+		return status;
+	sched_lock_unlock (lock);
+	pthread_cleanup_push (wait_cleanup, lock);
+	status = pthread_cond_wait (cond, &lock->wait_mutex);
+	pthread_cleanup_pop (1);
+	return status;
+}
+
+/*
+ * As sched_lock_wait, but give up at abstime (CLOCK_REALTIME) and
+ * return ETIMEDOUT.
+ */
+int sched_lock_timedwait (sched_lock_t *lock, pthread_cond_t *cond,
+	const struct timespec *abstime)
+{
+	int status;
+
+	if (lock->kind == SCHED_LOCK_MUTEX)
+		return pthread_cond_timedwait (cond, &lock->mutex, abstime);
+	status = pthread_mutex_lock (&lock->wait_mutex);
+	if (status != 0)
+		return status;
+	sched_lock_unlock (lock);
+	pthread_cleanup_push (wait_cleanup, lock);
+	status = pthread_cond_timedwait (cond, &lock->wait_mutex, abstime);
+	pthread_cleanup_pop (1);
+	return status;
+}
+
+/*
+ * Wake every waiter on cond. Call after the change they wait for has
+ * been made, with or without the lock held.
+ */
+int sched_lock_broadcast (sched_lock_t *lock, pthread_cond_t *cond)
+{
+	int status;
+
+	if (lock->kind == SCHED_LOCK_MUTEX)
+		return pthread_cond_broadcast (cond);
+	status = pthread_mutex_lock (&lock->wait_mutex);
+	if (status != 0)
+		return status;
+	status = pthread_cond_broadcast (cond);
+	pthread_mutex_unlock (&lock->wait_mutex);
+	return status;
+}
+
+/*
+ * Wake one waiter on cond, as sched_lock_broadcast wakes them all.
+ */
+int sched_lock_signal (sched_lock_t *lock, pthread_cond_t *cond)
+{
+	int status;
+
+	if (lock->kind == SCHED_LOCK_MUTEX)
+		return pthread_cond_signal (cond);
+	status = pthread_mutex_lock (&lock->wait_mutex);
+	if (status != 0)
+		return status;
+	status = pthread_cond_signal (cond);
+	pthread_mutex_unlock (&lock->wait_mutex);
+	return status;
+}
+
+const char *sched_lock_kind_name (sched_lock_kind_t kind)
+{
+	if (kind < 0 || kind >= SCHED_LOCK_NKINDS)
+		return "unknown";
+	return kind_names[kind];
+}
+
+/*
+ * Map a lock name as given on the command line to its kind.
+ * Returns 0 on success and -1 if the name is not recognised.
+ */
+int sched_lock_kind_parse (const char *name, sched_lock_kind_t *kind)
+{
+	int i;
+
+	for (i = 0; i < SCHED_LOCK_NKINDS; i++) {
+		if (strcmp (name, kind_names[i]) == 0) {
+			*kind = (sched_lock_kind_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
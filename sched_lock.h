@@ -0,0 +1,60 @@
+/*
+ * sched_lock.h
+ * The scheduler lock, alarm_mutex, that guards alarm_list and the
+ * threads' timer queues. Under contention a pthread mutex makes no
+ * promise about who gets it next, and main inserting alarms and the
+ * alarm threads polling the list can starve one another. The lock can
+ * instead be a ticket lock or an MCS queue lock (a2 -l), both of which
+ * hand the lock over in the order it was asked for.
+ *
+ * Condition waits work with every kind: for the queue locks the
+ * waiter and the waker meet on wait_mutex, which the waiter takes
+ * before it lets go of the lock, so no wakeup is lost as long as
+ * conditions waited on here are only signalled through
+ * sched_lock_signal and sched_lock_broadcast.
+ *
+ * An MCS waiter spins on a node of its own; a thread has one node, so
+ * it may hold only one MCS lock at a time. All functions return 0 or
+ * a pthread error number, like the pthread calls they stand in for.
+ */
+#ifndef __sched_lock_h
+#define __sched_lock_h
+
+#include <pthread.h>
+
+typedef enum {
+	SCHED_LOCK_MUTEX,   /* plain pthread mutex */
+	SCHED_LOCK_TICKET,  /* ticket lock, FIFO, one shared spin word */
+	SCHED_LOCK_MCS,     /* MCS queue lock, FIFO, each waiter spins locally */
+	SCHED_LOCK_NKINDS
+} sched_lock_kind_t;
+
+typedef struct sched_lock_node_tag {
+	struct sched_lock_node_tag  *next;
+	int                         locked;
+} sched_lock_node_t;
+
+typedef struct sched_lock_tag {
+	sched_lock_kind_t           kind;       /* set before the lock is first used */
+	pthread_mutex_t             mutex;      /* the lock itself for SCHED_LOCK_MUTEX */
+	pthread_mutex_t             wait_mutex; /* pairs condition waits with broadcasts */
+	unsigned long               next_ticket;
+	unsigned long               now_serving;
+	sched_lock_node_t           *tail;      /* last MCS waiter, NULL when free */
+} sched_lock_t;
+
+#define SCHED_LOCK_INITIALIZER \
+	{ SCHED_LOCK_MUTEX, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, 0, 0, NULL }
+
+int sched_lock_lock (sched_lock_t *lock);
+int sched_lock_unlock (sched_lock_t *lock);
+int sched_lock_wait (sched_lock_t *lock, pthread_cond_t *cond);
+int sched_lock_timedwait (sched_lock_t *lock, pthread_cond_t *cond,
+	const struct timespec *abstime);
+int sched_lock_signal (sched_lock_t *lock, pthread_cond_t *cond);
+int sched_lock_broadcast (sched_lock_t *lock, pthread_cond_t *cond);
+
+const char *sched_lock_kind_name (sched_lock_kind_t kind);
+int sched_lock_kind_parse (const char *name, sched_lock_kind_t *kind);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * shm_stats.c
+ * The shared memory stats segment; see shm_stats.h.
+ */
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_stats.h"
+#include "errors.h"
+
+#define SHM_NAME_MAX    256
+#define SHM_READ_TRIES  100000
+#define SHM_TYPE_HASH   (SHM_STATS_TYPES * 2)
+
+static const char *state_names[SHM_NSTATES] = {
+	"idle", "timing", "due", "overdue", "parked"
+};
+
+/*
+ * The name a2 created, so it can be removed at exit
+ */
+static char created[SHM_NAME_MAX];
+
+/*
+ * Open addressing from message type to snapshot->type slot, plus one,
+ * for shm_stats_type. Only the publisher uses it.
+ */
+static short type_slot[SHM_TYPE_HASH];
+
+/*
+ * Turn the name given on the command line into a shm_open name, which
+ * must start with a single '/'.
+ */
+static int shm_name (const char *name, char *path)
+{
+	while (*name == '/')
+		name++;
+	if (*name == '\0' || strchr (name, '/') != NULL
+			|| snprintf (path, SHM_NAME_MAX, "/%s", name) >= SHM_NAME_MAX)
+		return EINVAL;
+	return 0;
+}
+
+/*
+ * Create (or take over) the segment called name and map it for
+ * writing. Returns 0 or an errno value.
+ */
+int shm_stats_create (const char *name, shm_stats_t **segment)
+{
+	char path[SHM_NAME_MAX];
+	void *map;
+	int fd, status;
+
+	status = shm_name (name, path);
+	if (status != 0)
+		return status;
+	fd = shm_open (path, O_CREAT | O_RDWR, 0644);
+	if (fd < 0)
+		return errno;
+	if (ftruncate (fd, sizeof (shm_stats_t)) != 0) {
+		status = errno;
+		close (fd);
+		return status;
+	}
+	map = mmap (NULL, sizeof (shm_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	status = errno;
+	close (fd);
+	if (map == MAP_FAILED)
+		return status;
+	*segment = map;
+	memset (*segment, 0, sizeof (**segment));
+	(*segment)->version = SHM_STATS_VERSION;
+	(*segment)->pid = getpid ();
+	__atomic_store_n (&(*segment)->magic, SHM_STATS_MAGIC, __ATOMIC_RELEASE);
+	strcpy (created, path);
+	return 0;
+}
+
+/*
+ * Start a new snapshot: no threads and no types.
+ */
+void shm_stats_clear (shm_stats_t *snapshot)
+{
+	snapshot->threads = snapshot->threads_dropped = 0;
+	snapshot->types = snapshot->types_dropped = 0;
+	memset (type_slot, 0, sizeof (type_slot));
+}
+
+/*
+ * The snapshot's entry for a message type, added if it is new, or
+ * NULL when the table is full (counted in types_dropped).
+ */
+shm_type_t *shm_stats_type (shm_stats_t *snapshot, int type)
+{
+	unsigned long i = ((unsigned int)type * 2654435761u) % SHM_TYPE_HASH;
+	shm_type_t *entry;
+
+	while (type_slot[i] != 0) {
+		entry = &snapshot->type[type_slot[i] - 1];
+		if (entry->type == type)
+			return entry;
+		i = (i + 1) % SHM_TYPE_HASH;
+	}
+	if (snapshot->types == SHM_STATS_TYPES) {
+		snapshot->types_dropped++;
+		return NULL;
+	}
+	entry = &snapshot->type[snapshot->types++];
+	memset (entry, 0, sizeof (*entry));
+	entry->type = type;
+	type_slot[i] = (short)snapshot->types;
+	return entry;
+}
+
+/*
+ * Copy a snapshot into the segment. Only the rows in use are written.
+ * Readers that overlap the copy see seq change and try again.
+ */
+void shm_stats_publish (shm_stats_t *segment, const shm_stats_t *snapshot)
+{
+	unsigned long seq = segment->seq;
+
+	__atomic_store_n (&segment->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+	segment->dispatch = snapshot->dispatch;
+	segment->generation++;
+	segment->published = snapshot->published;
+	segment->counters = snapshot->counters;
+	segment->memory = snapshot->memory;
+	segment->threads = snapshot->threads;
+	segment->threads_dropped = snapshot->threads_dropped;
+	segment->types = snapshot->types;
+	segment->types_dropped = snapshot->types_dropped;
+	memcpy (segment->thread, snapshot->thread, snapshot->threads * sizeof (snapshot->thread[0]));
+	memcpy (segment->type, snapshot->type, snapshot->types * sizeof (snapshot->type[0]));
+	__atomic_store_n (&segment->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * Remove the segment this process created; for atexit.
+ */
+void shm_stats_remove (void)
+{
+	if (created[0] != '\0')
+		shm_unlink (created);
+	created[0] = '\0';
+}
+
+/*
+ * Map the segment called name read-only. Returns 0, an errno value,
+ * or EPROTO if it is not an a2 stats segment of this version.
+ */
+int shm_stats_attach (const char *name, const shm_stats_t **segment)
+{
+	char path[SHM_NAME_MAX];
+	struct stat st;
+	void *map;
+	int fd, status;
+
+	status = shm_name (name, path);
+	if (status != 0)
+		return status;
+	fd = shm_open (path, O_RDONLY, 0);
+	if (fd < 0)
+		return errno;
+	if (fstat (fd, &st) != 0 || st.st_size < (off_t)sizeof (shm_stats_t)) {
+		close (fd);
+		return EPROTO;
+	}
+	map = mmap (NULL, sizeof (shm_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+	status = errno;
+	close (fd);
+	if (map == MAP_FAILED)
+		return status;
+	*segment = map;
+	if (__atomic_load_n (&(*segment)->magic, __ATOMIC_ACQUIRE) != SHM_STATS_MAGIC
+			|| (*segment)->version != SHM_STATS_VERSION) {
+		munmap (map, sizeof (shm_stats_t));
+		return EPROTO;
+	}
+	return 0;
+}
+
+/*
+ * Take a consistent copy of the segment. The rows are copied after
+ * the header has said how many there are, and the copy only counts if
+ * seq was the same even number before and after. Adds the attempts
+ * that overlapped a publish to *retries, if given. Returns 0, or
+ * EAGAIN if the publisher never let a copy through (it died while
+ * writing, say).
+ */
+int shm_stats_read (const shm_stats_t *segment, shm_stats_t *copy, long *retries)
+{
+	unsigned long before, after;
+	long tries;
+
+	for (tries = 0; tries < SHM_READ_TRIES; tries++) {
+		before = __atomic_load_n (&segment->seq, __ATOMIC_ACQUIRE);
+		if (before & 1) {
+			if (retries != NULL)
+				(*retries)++;
+			continue;
+		}
+		memcpy (copy, segment, offsetof (shm_stats_t, thread));
+		if (copy->threads >= 0 && copy->threads <= SHM_STATS_THREADS
+				&& copy->types >= 0 && copy->types <= SHM_STATS_TYPES) {
+			memcpy (copy->thread, segment->thread, copy->threads * sizeof (copy->thread[0]));
+			memcpy (copy->type, segment->type, copy->types * sizeof (copy->type[0]));
+		}
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+		after = __atomic_load_n (&segment->seq, __ATOMIC_RELAXED);
+		if (after == before)
+			return 0;
+		if (retries != NULL)
+			(*retries)++;
+	}
+	return EAGAIN;
+}
+
+const char *shm_stats_state_name (int state)
+{
+	if (state < 0 || state >= SHM_NSTATES)
+		return "unknown";
+	return state_names[state];
+}
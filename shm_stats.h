@@ -0,0 +1,84 @@
+/*
+ * shm_stats.h
+ * a2's state published in a named shared memory segment for outside
+ * monitoring. With a2 -s <name> a publisher thread copies the
+ * counters, the memory each part of a2 holds, every alarm thread's
+ * state and the alarms waiting for each message type into
+ * /dev/shm/<name> once a second of real time, however fast -v runs
+ * the alarm clock.
+ * a2stat maps the segment read-only and displays it; reading it takes
+ * no lock and makes no system call into a2.
+ *
+ * The segment is a seqlock: the publisher makes seq odd, writes the
+ * snapshot and makes seq even again. shm_stats_read copies the
+ * segment and retries until seq was even and unchanged across the
+ * copy, so a reader never sees half of one snapshot and half of the
+ * next, and the publisher never waits for a reader.
+ */
+#ifndef __shm_stats_h
+#define __shm_stats_h
+
+#include <sys/types.h>
+#include <time.h>
+#include "stats.h"
+
+#define SHM_STATS_MAGIC     0x61327374UL    /* "a2st" */
+#define SHM_STATS_VERSION   6
+#define SHM_STATS_THREADS   256
+#define SHM_STATS_TYPES     256
+#define SHM_STATS_LABEL     24
+
+typedef enum shm_state_tag {
+	SHM_THREAD_IDLE,        /* no alarms */
+	SHM_THREAD_TIMING,      /* alarms, none of them due */
+	SHM_THREAD_DUE,         /* a due alarm not yet printed */
+	SHM_THREAD_OVERDUE,     /* reported by the watchdog */
+	SHM_THREAD_PARKED,      /* serving no type (a2 -k) */
+	SHM_NSTATES
+} shm_state_t;
+
+typedef struct shm_thread_tag {
+	long                thread;
+	char                type[SHM_STATS_LABEL];
+	int                 state;      /* shm_state_t */
+	long                queued;     /* alarms it holds */
+	long                late;       /* seconds its earliest due alarm is late */
+	unsigned long       fired;
+	unsigned long       passes;
+} shm_thread_t;
+
+typedef struct shm_type_tag {
+	int                 type;
+	long                waiting;    /* in alarm_list, not yet taken by a thread */
+	long                queued;     /* held by a thread */
+	long                late;       /* seconds the most overdue queue head is late */
+} shm_type_t;
+
+typedef struct shm_stats_tag {
+	unsigned long       magic;
+	unsigned long       version;
+	unsigned long       seq;        /* odd while a snapshot is being written */
+	pid_t               pid;
+	int                 dispatch;   /* a2 -m dispatch */
+	unsigned long       generation; /* snapshots published */
+	time_t              published;  /* alarm time of this snapshot */
+	stats_t             counters;
+	stats_memory_t      memory;
+	long                threads;
+	long                threads_dropped;    /* beyond SHM_STATS_THREADS */
+	long                types;
+	long                types_dropped;      /* beyond SHM_STATS_TYPES */
+	shm_thread_t        thread[SHM_STATS_THREADS];
+	shm_type_t          type[SHM_STATS_TYPES];
+} shm_stats_t;
+
+int shm_stats_create (const char *name, shm_stats_t **segment);
+void shm_stats_clear (shm_stats_t *snapshot);
+void shm_stats_publish (shm_stats_t *segment, const shm_stats_t *snapshot);
+void shm_stats_remove (void);
+int shm_stats_attach (const char *name, const shm_stats_t **segment);
+int shm_stats_read (const shm_stats_t *segment, shm_stats_t *copy, long *retries);
+shm_type_t *shm_stats_type (shm_stats_t *snapshot, int type);
+const char *shm_stats_state_name (int state);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * stats.c
+ * The statistics report; see stats.h.
+ */
+#include "stats.h"
+
+stats_t stats;
+
+/*
+ * Print every counter, one per line. The caller holds print_mutex so
+ * the report is not interleaved with alarm output.
+ */
+void stats_report (FILE *out, time_t now)
+{
+	fprintf (out, "Statistics at %ld:\n", (long)now);
+	fprintf (out, "  alarms accepted        %lu\n", STATS_READ (accepted));
+	fprintf (out, "  duplicates suppressed  %lu\n", STATS_READ (suppressed));
+	fprintf (out, "  alarms fired           %lu\n", STATS_READ (fired));
+	fprintf (out, "  threads overdue        %lu\n", STATS_READ (overdue));
+	fprintf (out, "  alarms redistributed   %lu\n", STATS_READ (redistributed));
+	fprintf (out, "  reader stalls          %lu\n", STATS_READ (reader_stalls));
+	fprintf (out, "  message bytes copied   %lu\n", STATS_READ (copied));
+	fprintf (out, "  threads reused         %lu\n", STATS_READ (reused));
+	fprintf (out, "  alarms throttled       %lu\n", STATS_READ (throttled));
+	fprintf (out, "  alarms dropped         %lu\n", STATS_READ (dropped));
+	fprintf (out, "  output lines dropped   %lu\n", STATS_READ (out_dropped));
+	fprintf (out, "  output lines spilled   %lu\n", STATS_READ (out_spilled));
+	fprintf (out, "  output waits           %lu\n", STATS_READ (out_waits));
+	fprintf (out, "  fired out of order     %lu\n", STATS_READ (unordered));
+	fprintf (out, "  fires summarised       %lu\n", STATS_READ (summarised));
+}
+
+static const char *memory_parts[STATS_MEM_NPARTS] = {
+	"alarm list", "thread queues", "messages", "thread nodes",
+	"thread stacks", "output buffers", "pooled alarms free"
+};
+
+/*
+ * Print one row per part and their total. Messages are inside the
+ * alarms, so they are left out of the total.
+ */
+void stats_memory_report (FILE *out, const stats_memory_t *memory, time_t now)
+{
+	unsigned long total = 0;
+	int i;
+
+	fprintf (out, "Memory at %ld:\n", (long)now);
+	fprintf (out, "  %-20s %10s %14s\n", "part", "objects", "bytes");
+	for (i = 0; i < STATS_MEM_NPARTS; i++) {
+		fprintf (out, "  %-20s %10ld %14lu\n", memory_parts[i], memory->objects[i],
+			memory->bytes[i]);
+		if (i != STATS_MEM_MESSAGES)
+			total += memory->bytes[i];
+	}
+	fprintf (out, "  %-20s %10s %14lu\n", "total", "", total);
+}
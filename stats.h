@@ -0,0 +1,66 @@
+/*
+ * stats.h
+ * Counters a2 keeps about its own work, printed by the "Stats:"
+ * command. Any thread may bump a counter with STATS_ADD; the updates
+ * are relaxed atomics, so counting never takes a lock on the alarm
+ * paths.
+ */
+#ifndef __stats_h
+#define __stats_h
+
+#include <stdio.h>
+#include <time.h>
+
+typedef struct stats_tag {
+	unsigned long       accepted;       /* alarms inserted into alarm_list */
+	unsigned long       suppressed;     /* duplicate alarms dropped before insertion */
+	unsigned long       fired;          /* alarms printed by alarm threads */
+	unsigned long       overdue;        /* late alarm threads reported by the watchdog */
+	unsigned long       redistributed;  /* alarms the watchdog moved to a sibling thread */
+	unsigned long       reader_stalls;  /* times the stdin reader found its ring full */
+	unsigned long       copied;         /* bytes of alarm message main has copied */
+	unsigned long       reused;         /* parked alarm threads given a new type */
+	unsigned long       throttled;      /* alarms delayed by a -t fire rate limit */
+	unsigned long       dropped;        /* alarms dropped by a -t fire rate limit */
+	unsigned long       out_dropped;    /* output lines dropped by the -o policy */
+	unsigned long       out_spilled;    /* output lines -o spill wrote to its file */
+	unsigned long       out_waits;      /* writes that waited for room with -o block */
+	unsigned long       unordered;      /* fired alarms -O could not write in order */
+	unsigned long       summarised;     /* fired alarms folded into -S summaries */
+} stats_t;
+
+extern stats_t stats;
+
+#define STATS_ADD(field, n) \
+	__atomic_fetch_add (&stats.field, (n), __ATOMIC_RELAXED)
+#define STATS_READ(field) \
+	__atomic_load_n (&stats.field, __ATOMIC_RELAXED)
+
+/*
+ * What each part of a2 holds in memory at one moment, for "Stats:
+ * Memory" and the -s segment. The alarm rows count alarm records
+ * wherever they wait; a message is stored inside its alarm, so the
+ * messages row is the part of those records the text fills. Stacks
+ * are address space reserved for the threads a2 started, most of it
+ * never resident.
+ */
+typedef enum stats_memory_part_tag {
+	STATS_MEM_ALARM_LIST,       /* alarms no thread has taken yet */
+	STATS_MEM_QUEUES,           /* alarms held in timer queues and mailboxes */
+	STATS_MEM_MESSAGES,         /* message text of those alarms */
+	STATS_MEM_THREAD_NODES,     /* alarm_thread_t and its watch or worker */
+	STATS_MEM_STACKS,
+	STATS_MEM_OUTPUT,           /* stdout buffer, -o ring, -O and -S tables */
+	STATS_MEM_POOL_FREE,        /* alarms back in the pool, not returned to malloc */
+	STATS_MEM_NPARTS
+} stats_memory_part_t;
+
+typedef struct stats_memory_tag {
+	long                objects[STATS_MEM_NPARTS];
+	unsigned long       bytes[STATS_MEM_NPARTS];
+} stats_memory_t;
+
+void stats_report (FILE *out, time_t now);
+void stats_memory_report (FILE *out, const stats_memory_t *memory, time_t now);
+
+#endif
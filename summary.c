@@ -0,0 +1,140 @@
+/*
+ * summary.c
+ * Burst summaries of fired alarms; see summary.h.
+ */
+#include "summary.h"
+#include "errors.h"
+#include "stats.h"
+
+/*
+ * Set up summaries for types firing more than rate alarms a second.
+ * A rate of 0 leaves them disabled.
+ */
+int summary_init (summary_t *summary, long rate)
+{
+	summary->rate = rate;
+	summary->types = NULL;
+	if (rate <= 0)
+		return 0;
+	summary->types = calloc (SUMMARY_TYPES, sizeof (summary_type_t));
+	return summary->types == NULL ? ENOMEM : 0;
+}
+
+/*
+ * The slot for type, claimed if it has none yet; NULL if the table is
+ * full.
+ */
+static summary_type_t *summary_find (summary_t *summary, unsigned int type)
+{
+	summary_type_t *slot;
+	long i, probe;
+
+	for (probe = 0; probe < SUMMARY_TYPES; probe++) {
+		i = (type + probe) & (SUMMARY_TYPES - 1);
+		slot = &summary->types[i];
+		if (slot->type == type)
+			return slot;
+		if (slot->type == 0) {
+			slot->type = type;
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Add the fires folded in from to those in into, leaving from empty.
+ */
+static void summary_merge (summary_span_t *into, summary_span_t *from)
+{
+	if (from->count == 0)
+		return;
+	if (into->count == 0) {
+		strcpy (into->first, from->first);
+		into->late_min = from->late_min;
+		into->late_max = from->late_max;
+	}
+	strcpy (into->last, from->last);
+	if (from->late_min < into->late_min)
+		into->late_min = from->late_min;
+	if (from->late_max > into->late_max)
+		into->late_max = from->late_max;
+	into->count += from->count;
+	from->count = 0;
+}
+
+/*
+ * Count a fire of type at now, late seconds after its deadline, and
+ * fold it into the type's summary if the type is bursting. Returns 1
+ * if it was folded and must not be printed, 0 if it should be.
+ */
+int summary_fold (summary_t *summary, unsigned int type, const char *message,
+	time_t late, time_t now)
+{
+	summary_type_t *slot;
+	summary_span_t *open;
+
+	if (summary->rate == 0 || (slot = summary_find (summary, type)) == NULL)
+		return 0;
+	if (slot->second != now) {
+		summary_merge (&slot->done, &slot->open);
+		slot->last_rate = slot->second == now - 1 ? slot->rate : 0;
+		slot->second = now;
+		slot->rate = 0;
+	}
+	slot->rate++;
+	if (!slot->bursting && slot->rate <= summary->rate)
+		return 0;
+	slot->bursting = 1;
+	open = &slot->open;
+	if (open->count == 0) {
+		strcpy (open->first, message);
+		open->late_min = open->late_max = late;
+	}
+	strcpy (open->last, message);
+	if (late < open->late_min)
+		open->late_min = late;
+	if (late > open->late_max)
+		open->late_max = late;
+	open->count++;
+	STATS_ADD (summarised, 1);
+	return 1;
+}
+
+/*
+ * Write a summary line for each type with fires folded before now and
+ * not yet reported, and let a type go back to printing alarm by alarm
+ * once the last whole second before now was at or under the rate, and
+ * so far the second now is too.
+ */
+void summary_report (summary_t *summary, time_t now, FILE *out)
+{
+	summary_type_t *slot;
+	summary_span_t *done;
+	long i, last;
+
+	if (summary->rate == 0)
+		return;
+	for (i = 0; i < SUMMARY_TYPES; i++) {
+		slot = &summary->types[i];
+		if (slot->type == 0)
+			continue;
+		done = &slot->done;
+		if (slot->second < now)
+			summary_merge (done, &slot->open);
+		if (done->count > 0) {
+			fprintf (out, "Alarms With Message Type (%u) Summarised at %d: %lu Fired, First \"%s\", Last \"%s\", %ld to %ld Seconds Late: Type A\n",
+				slot->type, (int)now, done->count, done->first, done->last,
+				(long)done->late_min, (long)done->late_max);
+			done->count = 0;
+		}
+		if (slot->second == now - 1)
+			last = slot->rate;
+		else if (slot->second == now)
+			last = slot->last_rate;
+		else
+			last = 0;
+		if (last <= summary->rate && (slot->second != now || slot->rate <= summary->rate))
+			slot->bursting = 0;
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * summary.h
+ * Burst summaries of fired alarms. With a2 -S RATE, once more than
+ * RATE alarms of one type fire in a second of alarm time, the rest of
+ * that type's fires stop printing their two lines each. They are
+ * folded into one summary line a second instead, with the count, the
+ * first and last messages and the range of lateness. A summary only
+ * covers seconds that have ended, so a burst falling due together is
+ * reported in one line. Once a whole second passes at or under RATE,
+ * the type prints alarm by alarm again.
+ *
+ * The types seen are kept in an open-addressed table of SUMMARY_TYPES
+ * slots, allocated by summary_init; fires of types beyond that are
+ * printed as usual. Fires folded into summaries are counted in
+ * "Stats:". Everything here is guarded by print_mutex.
+ */
+#ifndef __summary_h
+#define __summary_h
+
+#include <stdio.h>
+#include <time.h>
+#include "command.h"
+
+#define SUMMARY_TYPES       1024    /* a power of two */
+
+typedef struct summary_span_tag {
+	unsigned long       count;      /* fires folded */
+	time_t              late_min;
+	time_t              late_max;
+	char                first[CMD_MESSAGE_MAX + 1];
+	char                last[CMD_MESSAGE_MAX + 1];
+} summary_span_t;
+
+typedef struct summary_type_tag {
+	unsigned int        type;       /* 0: slot unused */
+	time_t              second;     /* the second rate counts */
+	long                rate;       /* fires in that second */
+	long                last_rate;  /* fires in the second before it */
+	int                 bursting;
+	summary_span_t      done;       /* folded before second, not reported */
+	summary_span_t      open;       /* folded in second */
+} summary_type_t;
+
+typedef struct summary_tag {
+	long                rate;       /* 0 disables summaries */
+	summary_type_t      *types;
+} summary_t;
+
+int summary_init (summary_t *summary, long rate);
+int summary_fold (summary_t *summary, unsigned int type, const char *message,
+	time_t late, time_t now);
+void summary_report (summary_t *summary, time_t now, FILE *out);
+
+#endif
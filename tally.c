@@ -0,0 +1,50 @@
+/*
+ * tally.c
+ * Running per-type alarm counts; see tally.h.
+ */
+#include "tally.h"
+#include "errors.h"
+
+/*
+ * Set up a tally; one that is not enabled is left empty and counts
+ * nothing.
+ */
+int tally_init (tally_t *tally, int enabled)
+{
+	tally->count = 0;
+	tally->types = NULL;
+	tally->used = NULL;
+	if (!enabled)
+		return 0;
+	tally->types = calloc (TALLY_TYPES, sizeof (tally_type_t));
+	tally->used = calloc (TALLY_TYPES, sizeof (long));
+	if (tally->types == NULL || tally->used == NULL)
+		return ENOMEM;
+	return 0;
+}
+
+/*
+ * Add waiting and queued, either of which may be negative, to the
+ * counts for type.
+ */
+void tally_add (tally_t *tally, unsigned int type, long waiting, long queued)
+{
+	tally_type_t *slot;
+	long i, probe;
+
+	if (tally->types == NULL)
+		return;
+	for (probe = 0; probe < TALLY_TYPES; probe++) {
+		i = (type + probe) & (TALLY_TYPES - 1);
+		slot = &tally->types[i];
+		if (slot->type == 0) {
+			slot->type = type;
+			tally->used[tally->count++] = i;
+		}
+		if (slot->type == type) {
+			slot->waiting += waiting;
+			slot->queued += queued;
+			return;
+		}
+	}
+}
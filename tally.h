@@ -0,0 +1,34 @@
+/*
+ * tally.h
+ * Running counts of the pending alarms of each message type: waiting
+ * in alarm_list, or held in a timer queue. a2 adjusts them where an
+ * alarm enters the index, is taken by a thread and leaves, so the -s
+ * publisher reports them without walking the pending alarms.
+ *
+ * The types seen are kept in an open-addressed table of TALLY_TYPES
+ * slots, allocated by tally_init, and listed in the order they were
+ * first seen so the publisher only visits slots in use. Alarms of
+ * types beyond that are not counted, and a tally that was not enabled
+ * counts nothing. Everything here is guarded by alarm_mutex.
+ */
+#ifndef __tally_h
+#define __tally_h
+
+#define TALLY_TYPES         4096    /* a power of two */
+
+typedef struct tally_type_tag {
+	unsigned int        type;       /* 0: slot unused */
+	long                waiting;    /* in alarm_list */
+	long                queued;     /* in a timer queue */
+} tally_type_t;
+
+typedef struct tally_tag {
+	tally_type_t        *types;
+	long                *used;      /* slots in use, as types were first seen */
+	long                count;
+} tally_t;
+
+int tally_init (tally_t *tally, int enabled);
+void tally_add (tally_t *tally, unsigned int type, long waiting, long queued);
+
+#endif
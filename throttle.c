@@ -0,0 +1,118 @@
+/*
+ * throttle.c
+ * Per-type fire rate limits; see throttle.h.
+ */
+#include "throttle.h"
+#include "errors.h"
+
+static int bucket_by_type (const void *a, const void *b)
+{
+	const throttle_bucket_t *x = a, *y = b;
+
+	return (x->type > y->type) - (x->type < y->type);
+}
+
+static throttle_bucket_t *throttle_find (throttle_t *throttle, unsigned int type)
+{
+	throttle_bucket_t key;
+
+	if (throttle->count == 0)
+		return NULL;
+	key.type = type;
+	return bsearch (&key, throttle->buckets, throttle->count,
+		sizeof (throttle_bucket_t), bucket_by_type);
+}
+
+/*
+ * Add the limit "TYPE:RATE" or "LO-HI:RATE", optionally followed by
+ * ":drop" or ":delay" (the default). A type named again takes the new
+ * limit. Returns 0, -1 if spec is malformed, or ENOMEM.
+ */
+int throttle_add (throttle_t *throttle, const char *spec)
+{
+	throttle_bucket_t *buckets, *bucket;
+	unsigned long lo, hi, type;
+	long rate, added = 0;
+	int drop = 0;
+	char *end;
+
+	lo = strtoul (spec, &end, 10);
+	hi = lo;
+	if (*end == '-')
+		hi = strtoul (end + 1, &end, 10);
+	if (end == spec || *end != ':' || lo < 1 || hi < lo || hi - lo >= THROTTLE_RANGE_MAX
+			|| hi > (unsigned int)-1)
+		return -1;
+	spec = end + 1;
+	rate = strtol (spec, &end, 10);
+	if (end == spec || rate < 1)
+		return -1;
+	if (strcmp (end, ":drop") == 0)
+		drop = 1;
+	else if (*end != '\0' && strcmp (end, ":delay") != 0)
+		return -1;
+
+	buckets = realloc (throttle->buckets,
+		(throttle->count + hi - lo + 1) * sizeof (throttle_bucket_t));
+	if (buckets == NULL)
+		return ENOMEM;
+	throttle->buckets = buckets;
+	for (type = lo; type <= hi; type++) {
+		bucket = throttle_find (throttle, (unsigned int)type);
+		if (bucket == NULL)
+			bucket = &buckets[throttle->count + added++];
+		bucket->type = (unsigned int)type;
+		bucket->rate = rate;
+		bucket->drop = drop;
+		bucket->second = 0;
+		bucket->taken = 0;
+	}
+	throttle->count += added;
+	qsort (buckets, throttle->count, sizeof (throttle_bucket_t), bucket_by_type);
+	return 0;
+}
+
+/*
+ * Take a token for an alarm of type falling due at now. On
+ * THROTTLE_DELAY the token is already taken from the second put in
+ * *when, and the alarm should fire then without another check.
+ * Requires alarm_mutex.
+ */
+throttle_verdict_t throttle_check (throttle_t *throttle, unsigned int type,
+	time_t now, time_t *when)
+{
+	throttle_bucket_t *bucket;
+
+	bucket = throttle_find (throttle, type);
+	if (bucket == NULL)
+		return THROTTLE_FIRE;
+	if (bucket->second < now) {
+		bucket->second = now;
+		bucket->taken = 0;
+	}
+	if (bucket->taken == bucket->rate) {
+		if (bucket->drop)
+			return THROTTLE_DROP;
+		bucket->second++;
+		bucket->taken = 0;
+	}
+	bucket->taken++;
+	*when = bucket->second;
+	return bucket->second == now ? THROTTLE_FIRE : THROTTLE_DELAY;
+}
+
+/*
+ * Give back the token an alarm of type delayed to second took, when it
+ * is rescheduled before firing and will be checked again. Only the
+ * latest second's tokens are still counted; an earlier second was
+ * full when the bucket moved past it, so nothing is owed to it.
+ * Requires alarm_mutex.
+ */
+void throttle_release (throttle_t *throttle, unsigned int type, time_t second)
+{
+	throttle_bucket_t *bucket;
+
+	bucket = throttle_find (throttle, type);
+	if (bucket != NULL && bucket->second == second && bucket->taken > 0)
+		bucket->taken--;
+}
@@ -0,0 +1,48 @@
+/*
+ * throttle.h
+ * Per-type limits on how fast alarms fire. With a2 -t TYPE:RATE (or
+ * -t LO-HI:RATE for a range of types) no more than RATE alarms of each
+ * of those types fire in any one second of alarm time, however many
+ * fall due together. An alarm over the limit is delayed to the next
+ * second that has room for it, or with -t TYPE:RATE:drop, dropped.
+ *
+ * Each type has a token bucket holding a second's worth of tokens and
+ * refilled as the alarm clock ticks. A delayed alarm takes its token
+ * from the second it is moved to, so it fires then without being
+ * checked again and is never delayed twice. The buckets are built
+ * before any thread starts and only changed under alarm_mutex, which
+ * every mode already holds where it decides an alarm is due, so
+ * throttling adds no lock and allocates nothing.
+ */
+#ifndef __throttle_h
+#define __throttle_h
+
+#include <time.h>
+
+#define THROTTLE_RANGE_MAX  65536   /* types one -t may name */
+
+typedef enum throttle_verdict_tag {
+	THROTTLE_FIRE,          /* a token was free this second */
+	THROTTLE_DELAY,         /* fire at the second returned in *when */
+	THROTTLE_DROP
+} throttle_verdict_t;
+
+typedef struct throttle_bucket_tag {
+	unsigned int        type;
+	long                rate;       /* alarms a second */
+	int                 drop;       /* drop rather than delay */
+	time_t              second;     /* latest second tokens were taken from */
+	long                taken;      /* tokens taken from that second */
+} throttle_bucket_t;
+
+typedef struct throttle_tag {
+	throttle_bucket_t   *buckets;   /* ascending by type */
+	long                count;
+} throttle_t;
+
+int throttle_add (throttle_t *throttle, const char *spec);
+throttle_verdict_t throttle_check (throttle_t *throttle, unsigned int type,
+	time_t now, time_t *when);
+void throttle_release (throttle_t *throttle, unsigned int type, time_t second);
+
+#endif
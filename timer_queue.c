@@ -0,0 +1,460 @@
+/*
+ * timer_queue.c
+ * Backends for the per-thread pending structure declared in
+ * timer_queue.h. Every backend orders entries by (key, seq), so a
+ * thread fires its alarms in the same order whichever one is chosen.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timer_queue.h"
+
+#define HEAP_ARITY      4
+#define WHEEL_MASK      (TIMERQ_WHEEL_SLOTS - 1)
+
+static const char *kind_names[TIMERQ_NKINDS] = {
+	"list", "heap", "pairing", "wheel"
+};
+
+/*
+ * Strict ordering used by all backends: earlier key first, and the
+ * earlier insertion first among equal keys.
+ */
+static int node_before (const timerq_node_t *a, const timerq_node_t *b)
+{
+	return a->key < b->key || (a->key == b->key && a->seq < b->seq);
+}
+
+/*
+ * Sorted doubly linked list. Insertion walks from the head, which is
+ * what alarm_thread did before the structure was made pluggable.
+ */
+static void list_insert (timerq_node_t **head, timerq_node_t *node)
+{
+	timerq_node_t **last, *next;
+
+	node->prev = NULL;
+	last = head;
+	next = *last;
+	while (next != NULL && !node_before (node, next)) {
+		last = &next->next;
+		node->prev = next;
+		next = next->next;
+	}
+	node->next = next;
+	if (next != NULL)
+		next->prev = node;
+	*last = node;
+}
+
+static void list_unlink (timerq_node_t **head, timerq_node_t *node)
+{
+	if (node->prev == NULL)
+		*head = node->next;
+	else
+		node->prev->next = node->next;
+	if (node->next != NULL)
+		node->next->prev = node->prev;
+}
+
+/*
+ * Implicit 4-ary min-heap. Each node remembers its slot so it can be
+ * removed from the middle of the heap without a search.
+ */
+static void heap_sift_up (timerq_node_t **slots, long i)
+{
+	timerq_node_t *node = slots[i];
+	long parent;
+
+	while (i > 0) {
+		parent = (i - 1) / HEAP_ARITY;
+		if (!node_before (node, slots[parent]))
+			break;
+		slots[i] = slots[parent];
+		slots[i]->index = i;
+		i = parent;
+	}
+	slots[i] = node;
+	node->index = i;
+}
+
+static void heap_sift_down (timerq_node_t **slots, long size, long i)
+{
+	timerq_node_t *node = slots[i];
+	long child, best, last;
+
+	while (1) {
+		child = i * HEAP_ARITY + 1;
+		if (child >= size)
+			break;
+		last = child + HEAP_ARITY < size ? child + HEAP_ARITY : size;
+		for (best = child++; child < last; child++)
+			if (node_before (slots[child], slots[best]))
+				best = child;
+		if (!node_before (slots[best], node))
+			break;
+		slots[i] = slots[best];
+		slots[i]->index = i;
+		i = best;
+	}
+	slots[i] = node;
+	node->index = i;
+}
+
+static int heap_grow (timerq_t *q, long capacity)
+{
+	timerq_node_t **slots;
+
+	slots = realloc (q->slots, capacity * sizeof (*slots));
+	if (slots == NULL)
+		return ENOMEM;
+	q->slots = slots;
+	q->capacity = capacity;
+	return 0;
+}
+
+static int heap_insert (timerq_t *q, timerq_node_t *node)
+{
+	int status;
+
+	if (q->count == q->capacity) {
+		status = heap_grow (q, q->capacity ? q->capacity * 2 : 16);
+		if (status != 0)
+			return status;
+	}
+	q->slots[q->count] = node;
+	heap_sift_up (q->slots, q->count);
+	return 0;
+}
+
+static void heap_remove (timerq_t *q, timerq_node_t *node)
+{
+	long i = node->index, size = q->count - 1;
+	timerq_node_t *last = q->slots[size];
+
+	if (i != size) {
+		q->slots[i] = last;
+		last->index = i;
+		if (i > 0 && node_before (last, q->slots[(i - 1) / HEAP_ARITY]))
+			heap_sift_up (q->slots, i);
+		else
+			heap_sift_down (q->slots, size, i);
+	}
+}
+
+/*
+ * Pairing heap. A node's children hang off "child" and are chained
+ * through "next"; "prev" points at the left sibling, or at the parent
+ * for the leftmost child, so any node can be cut out in O(1).
+ */
+static timerq_node_t *pairing_meld (timerq_node_t *a, timerq_node_t *b)
+{
+	timerq_node_t *tmp;
+
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (node_before (b, a)) {
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/*
+ * Standard two-pass combine of a sibling list: meld pairs left to
+ * right, then fold the results together right to left.
+ */
+static timerq_node_t *pairing_merge_pairs (timerq_node_t *first)
+{
+	timerq_node_t *a, *b, *next, *pairs = NULL, *result = NULL;
+
+	while (first != NULL) {
+		a = first;
+		b = a->next;
+		next = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL) {
+			b->next = b->prev = NULL;
+			a = pairing_meld (a, b);
+		}
+		a->next = pairs;
+		pairs = a;
+		first = next;
+	}
+	while (pairs != NULL) {
+		next = pairs->next;
+		pairs->next = NULL;
+		result = pairing_meld (result, pairs);
+		pairs = next;
+	}
+	return result;
+}
+
+static void pairing_remove (timerq_t *q, timerq_node_t *node)
+{
+	timerq_node_t *sub = pairing_merge_pairs (node->child);
+
+	if (node == q->head) {
+		q->head = sub;
+	} else {
+		if (node->prev->child == node)
+			node->prev->child = node->next;
+		else
+			node->prev->next = node->next;
+		if (node->next != NULL)
+			node->next->prev = node->prev;
+		q->head = pairing_meld (q->head, sub);
+	}
+	if (q->head != NULL)
+		q->head->prev = q->head->next = NULL;
+}
+
+/*
+ * Hashed timing wheel. Bucket (t & WHEEL_MASK) holds entries whose
+ * tick t lies within TIMERQ_WHEEL_SLOTS of the cursor tick "base";
+ * entries already behind the cursor share the cursor bucket. Later
+ * entries wait in a sorted overflow list (q->head) and are moved
+ * into the wheel as the cursor reaches them. Buckets are unsorted,
+ * so the minimum is found by scanning the first non-empty bucket.
+ */
+static long long wheel_tick (long long key)
+{
+	return key / TIMERQ_WHEEL_TICK;
+}
+
+static void wheel_place (timerq_t *q, timerq_node_t *node)
+{
+	long long tick = wheel_tick (node->key);
+	long bucket;
+
+	if (tick >= q->base + TIMERQ_WHEEL_SLOTS) {
+		node->index = -1;
+		list_insert (&q->head, node);
+		return;
+	}
+	if (tick < q->base)
+		tick = q->base;
+	bucket = tick & WHEEL_MASK;
+	node->prev = NULL;
+	node->next = q->slots[bucket];
+	if (node->next != NULL)
+		node->next->prev = node;
+	q->slots[bucket] = node;
+	node->index = bucket;
+	q->in_wheel++;
+}
+
+static void wheel_migrate (timerq_t *q)
+{
+	timerq_node_t *node;
+
+	while (q->head != NULL
+			&& wheel_tick (q->head->key) < q->base + TIMERQ_WHEEL_SLOTS) {
+		node = q->head;
+		list_unlink (&q->head, node);
+		wheel_place (q, node);
+	}
+}
+
+static timerq_node_t *wheel_peek (timerq_t *q)
+{
+	timerq_node_t *node, *min;
+	long i;
+
+	if (q->in_wheel == 0) {
+		if (q->head == NULL)
+			return NULL;
+		q->base = wheel_tick (q->head->key);
+		wheel_migrate (q);
+	}
+	for (i = 0; q->slots[(q->base + i) & WHEEL_MASK] == NULL; i++)
+		;
+	if (i > 0) {
+		q->base += i;
+		wheel_migrate (q);
+	}
+	min = q->slots[q->base & WHEEL_MASK];
+	for (node = min->next; node != NULL; node = node->next)
+		if (node_before (node, min))
+			min = node;
+	return min;
+}
+
+static void wheel_remove (timerq_t *q, timerq_node_t *node)
+{
+	if (node->index < 0) {
+		list_unlink (&q->head, node);
+		return;
+	}
+	list_unlink (&q->slots[node->index], node);
+	q->in_wheel--;
+}
+
+int timerq_init (timerq_t *q, timerq_kind_t kind)
+{
+	memset (q, 0, sizeof (*q));
+	q->kind = kind;
+	if (kind == TIMERQ_WHEEL) {
+		q->slots = calloc (TIMERQ_WHEEL_SLOTS, sizeof (*q->slots));
+		if (q->slots == NULL)
+			return ENOMEM;
+	}
+	return 0;
+}
+
+/*
+ * Release the backend's own storage. Queued nodes belong to the
+ * caller and must have been popped first if they are to be freed.
+ */
+void timerq_destroy (timerq_t *q)
+{
+	free (q->slots);
+	q->slots = NULL;
+	q->head = NULL;
+	q->count = q->capacity = q->in_wheel = 0;
+}
+
+/*
+ * Size the backend for count entries so that inserting up to that
+ * many never allocates. Only the heap keeps storage proportional to
+ * its size; the other backends have nothing to reserve.
+ */
+int timerq_reserve (timerq_t *q, long count)
+{
+	if (q->kind == TIMERQ_HEAP && count > q->capacity)
+		return heap_grow (q, count);
+	return 0;
+}
+
+/*
+ * Bytes of the backend's own storage: the heap array or the wheel's
+ * buckets. Nodes belong to the caller and are not counted.
+ */
+size_t timerq_footprint (const timerq_t *q)
+{
+	if (q->kind == TIMERQ_HEAP)
+		return q->capacity * sizeof (*q->slots);
+	if (q->kind == TIMERQ_WHEEL)
+		return TIMERQ_WHEEL_SLOTS * sizeof (*q->slots);
+	return 0;
+}
+
+int timerq_insert (timerq_t *q, timerq_node_t *node)
+{
+	int status = 0;
+
+	node->next = node->prev = node->child = NULL;
+	node->index = -1;
+	node->seq = q->next_seq++;
+	switch (q->kind) {
+	case TIMERQ_LIST:
+		list_insert (&q->head, node);
+		break;
+	case TIMERQ_HEAP:
+		status = heap_insert (q, node);
+		break;
+	case TIMERQ_PAIRING:
+		q->head = pairing_meld (q->head, node);
+		break;
+	case TIMERQ_WHEEL:
+		if (q->count == 0)
+			q->base = wheel_tick (node->key);
+		wheel_place (q, node);
+		break;
+	default:
+		status = EINVAL;
+	}
+	if (status == 0)
+		q->count++;
+	return status;
+}
+
+timerq_node_t *timerq_peek (timerq_t *q)
+{
+	if (q->count == 0)
+		return NULL;
+	switch (q->kind) {
+	case TIMERQ_HEAP:
+		return q->slots[0];
+	case TIMERQ_WHEEL:
+		return wheel_peek (q);
+	default:
+		return q->head;
+	}
+}
+
+void timerq_remove (timerq_t *q, timerq_node_t *node)
+{
+	switch (q->kind) {
+	case TIMERQ_LIST:
+		list_unlink (&q->head, node);
+		break;
+	case TIMERQ_HEAP:
+		heap_remove (q, node);
+		break;
+	case TIMERQ_PAIRING:
+		pairing_remove (q, node);
+		break;
+	case TIMERQ_WHEEL:
+		wheel_remove (q, node);
+		break;
+	default:
+		return;
+	}
+	node->next = node->prev = node->child = NULL;
+	node->index = -1;
+	q->count--;
+}
+
+/*
+ * Move a queued node to a new key. The node goes behind any entries
+ * already holding that key. The slot it frees is the one it reuses,
+ * so this never allocates and is O(log n) on the heaps.
+ */
+int timerq_update (timerq_t *q, timerq_node_t *node, long long key)
+{
+	timerq_remove (q, node);
+	node->key = key;
+	return timerq_insert (q, node);
+}
+
+timerq_node_t *timerq_pop (timerq_t *q)
+{
+	timerq_node_t *node = timerq_peek (q);
+
+	if (node != NULL)
+		timerq_remove (q, node);
+	return node;
+}
+
+const char *timerq_kind_name (timerq_kind_t kind)
+{
+	if (kind < 0 || kind >= TIMERQ_NKINDS)
+		return "unknown";
+	return kind_names[kind];
+}
+
+/*
+ * Map a backend name as given on the command line to its kind.
+ * Returns 0 on success and -1 if the name is not recognised.
+ */
+int timerq_kind_parse (const char *name, timerq_kind_t *kind)
+{
+	int i;
+
+	for (i = 0; i < TIMERQ_NKINDS; i++) {
+		if (strcmp (name, kind_names[i]) == 0) {
+			*kind = (timerq_kind_t)i;
+			return 0;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,68 @@
+/*
+ * timer_queue.h
+ * The pending structure each alarm thread keeps its assigned alarms
+ * in. It used to be a sorted linked list written directly into
+ * alarm_thread; it is now a small interface with several backends
+ * so the structure can be chosen per deployment (see the -q flag of
+ * a2 and bench/timerq_bench.c).
+ *
+ * Nodes are intrusive: the caller embeds a timerq_node_t in its own
+ * record and the queue never allocates or frees nodes. Entries are
+ * ordered by key, and entries with equal keys come out in the order
+ * they were inserted, whichever backend is used.
+ */
+#ifndef __timer_queue_h
+#define __timer_queue_h
+
+#include <stddef.h>
+
+typedef struct timerq_node_tag {
+	struct timerq_node_tag  *next;      /* list/bucket successor, pairing sibling */
+	struct timerq_node_tag  *prev;      /* list/bucket predecessor, pairing parent or left sibling */
+	struct timerq_node_tag  *child;     /* pairing heap leftmost child */
+	long                    index;      /* heap slot or wheel bucket, -1 when in no slot */
+	unsigned long           seq;        /* insertion order, breaks ties on key */
+	long long               key;        /* deadline; smallest key is served first */
+} timerq_node_t;
+
+typedef enum {
+	TIMERQ_LIST,        /* sorted doubly linked list, O(n) insert */
+	TIMERQ_HEAP,        /* implicit 4-ary heap, O(log n) insert and pop */
+	TIMERQ_PAIRING,     /* pairing heap, O(1) insert, O(log n) amortised pop */
+	TIMERQ_WHEEL,       /* hashed timing wheel with a sorted overflow list */
+	TIMERQ_NKINDS
+} timerq_kind_t;
+
+/*
+ * Number of buckets in the timing wheel and the key range covered by
+ * each bucket. With keys in seconds the wheel spans about seventeen
+ * minutes; later deadlines wait in the overflow list.
+ */
+#define TIMERQ_WHEEL_SLOTS  1024
+#define TIMERQ_WHEEL_TICK   1
+
+typedef struct timerq_tag {
+	timerq_kind_t           kind;
+	long                    count;      /* entries currently queued */
+	unsigned long           next_seq;
+	timerq_node_t           *head;      /* list head, pairing root, wheel overflow */
+	timerq_node_t           **slots;    /* heap array or wheel buckets */
+	long                    capacity;   /* heap slots allocated */
+	long long               base;       /* wheel tick of the cursor bucket */
+	long                    in_wheel;   /* wheel entries not in overflow */
+} timerq_t;
+
+int timerq_init (timerq_t *q, timerq_kind_t kind);
+void timerq_destroy (timerq_t *q);
+int timerq_reserve (timerq_t *q, long count);
+size_t timerq_footprint (const timerq_t *q);
+int timerq_insert (timerq_t *q, timerq_node_t *node);
+timerq_node_t *timerq_peek (timerq_t *q);
+timerq_node_t *timerq_pop (timerq_t *q);
+void timerq_remove (timerq_t *q, timerq_node_t *node);
+int timerq_update (timerq_t *q, timerq_node_t *node, long long key);
+
+const char *timerq_kind_name (timerq_kind_t kind);
+int timerq_kind_parse (const char *name, timerq_kind_t *kind);
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ * trace.c
+ * Writing and reading command traces; see trace.h.
+ */
+#include <time.h>
+#include "trace.h"
+#include "errors.h"
+
+static unsigned long long clock_ns (clockid_t clock)
+{
+	struct timespec now;
+
+	clock_gettime (clock, &now);
+	return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int put_varint (FILE *file, unsigned long long value)
+{
+	while (value >= 0x80) {
+		if (putc ((int)(value & 0x7f) | 0x80, file) == EOF)
+			return EOF;
+		value >>= 7;
+	}
+	return putc ((int)value, file);
+}
+
+/*
+ * Read a varint; EOF if the trace ends before or inside it, EIO if it
+ * cannot be read, EINVAL if it is too long to be one of ours.
+ */
+static int get_varint (FILE *file, unsigned long long *value)
+{
+	int c, shift = 0;
+
+	*value = 0;
+	while ((c = getc (file)) != EOF) {
+		*value |= (unsigned long long)(c & 0x7f) << shift;
+		if ((c & 0x80) == 0)
+			return 0;
+		shift += 7;
+		if (shift > 63)
+			return EINVAL;
+	}
+	return ferror (file) ? EIO : EOF;
+}
+
+/*
+ * Start a trace in path, replacing any file there. Returns 0 or an
+ * errno value.
+ */
+int trace_create (trace_t *trace, const char *path)
+{
+	unsigned char header[TRACE_HEADER];
+	int i;
+
+	memset (trace, 0, sizeof (*trace));
+	trace->file = fopen (path, "wb");
+	if (trace->file == NULL)
+		return errno;
+	setvbuf (trace->file, trace->buffer, _IOFBF, sizeof (trace->buffer));
+	trace->start = clock_ns (CLOCK_REALTIME);
+	trace->origin = clock_ns (CLOCK_MONOTONIC);
+	memcpy (header, TRACE_MAGIC, 4);
+	header[4] = TRACE_VERSION;
+	for (i = 0; i < 8; i++)
+		header[5 + i] = (unsigned char)(trace->start >> (8 * i));
+	if (fwrite (header, 1, sizeof (header), trace->file) != sizeof (header))
+		return errno;
+	return 0;
+}
+
+/*
+ * Record line as arriving now. A trailing newline is not stored.
+ * Returns 0 or an errno value.
+ */
+int trace_write (trace_t *trace, const char *line)
+{
+	unsigned long long at = clock_ns (CLOCK_MONOTONIC) - trace->origin;
+	size_t len = strcspn (line, "\n");
+
+	if (put_varint (trace->file, at - trace->last) == EOF
+			|| put_varint (trace->file, len) == EOF
+			|| fwrite (line, 1, len, trace->file) != len)
+		return errno;
+	trace->last = at;
+	return 0;
+}
+
+/*
+ * Write out what is buffered, keeping the file open. Returns 0 or an
+ * errno value.
+ */
+int trace_sync (trace_t *trace)
+{
+	if (fflush (trace->file) == EOF)
+		return errno;
+	return 0;
+}
+
+/*
+ * Write out what is buffered and close the file. Returns 0 or an
+ * errno value.
+ */
+int trace_close (trace_t *trace)
+{
+	int status = 0;
+
+	if (trace->file == NULL)
+		return 0;
+	if (fclose (trace->file) != 0)
+		status = errno;
+	trace->file = NULL;
+	return status;
+}
+
+/*
+ * Open the trace in path for trace_read. Returns 0, an errno value,
+ * or EINVAL if it is not a trace this version can read.
+ */
+int trace_open (trace_t *trace, const char *path)
+{
+	unsigned char header[TRACE_HEADER];
+	int i;
+
+	memset (trace, 0, sizeof (*trace));
+	trace->file = fopen (path, "rb");
+	if (trace->file == NULL)
+		return errno;
+	setvbuf (trace->file, trace->buffer, _IOFBF, sizeof (trace->buffer));
+	if (fread (header, 1, sizeof (header), trace->file) != sizeof (header)
+			|| memcmp (header, TRACE_MAGIC, 4) != 0 || header[4] != TRACE_VERSION) {
+		fclose (trace->file);
+		trace->file = NULL;
+		return EINVAL;
+	}
+	for (i = 0; i < 8; i++)
+		trace->start |= (unsigned long long)header[5 + i] << (8 * i);
+	return 0;
+}
+
+/*
+ * Read the next command into line, which holds size bytes, with the
+ * nanoseconds from the start of the capture to its arrival in at.
+ * Returns 0, EOF at the end of the trace, or EINVAL if a record is
+ * corrupt or its command does not fit in line. A last record cut off
+ * part-way, as a capture that was killed leaves it, is dropped and
+ * counts as the end.
+ */
+int trace_read (trace_t *trace, unsigned long long *at, char *line, size_t size)
+{
+	unsigned long long delta, len;
+	int status;
+
+	status = get_varint (trace->file, &delta);
+	if (status != 0)
+		return status;
+	status = get_varint (trace->file, &len);
+	if (status != 0)
+		return status;
+	if (len >= size)
+		return EINVAL;
+	if (fread (line, 1, len, trace->file) != len)
+		return ferror (trace->file) ? EIO : EOF;
+	line[len] = '\0';
+	trace->last += delta;
+	*at = trace->last;
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * trace.h
+ * Capture of main's input for replay. With a2 -T <file>, every
+ * command main takes is written to a binary trace with the time it
+ * arrived, and a2replay feeds a trace back to a2 at the pace it was
+ * captured, some multiple of it, or as fast as a2 will read.
+ *
+ * A trace is a header followed by one record per command:
+ *
+ *   header  "a2tr", a version byte, and the real time capture began
+ *           as eight bytes of nanoseconds, least significant first
+ *   record  nanoseconds since the record before (or since the start,
+ *           for the first) and the length of the command, each as an
+ *           unsigned LEB128 varint, then the command without its
+ *           newline
+ *
+ * Arrival times are read from CLOCK_MONOTONIC, so they follow the
+ * real clock whatever -v does to the alarm clock. Commands arriving
+ * every few milliseconds cost a record of three or four bytes plus
+ * the text.
+ *
+ * Records are buffered and written out with trace_sync, which a2 calls
+ * every TRACE_SYNC seconds and when it is stopped. A capture killed
+ * outright can still end part-way through a record; trace_read takes
+ * that as the end of the trace.
+ */
+#ifndef __trace_h
+#define __trace_h
+
+#include <stdio.h>
+
+#define TRACE_MAGIC     "a2tr"
+#define TRACE_VERSION   1
+#define TRACE_HEADER    13          /* magic, version, start time */
+#define TRACE_BUFFER    65536       /* stdio buffer for the file */
+#define TRACE_LINE      256         /* longest command, as main reads them */
+#define TRACE_SYNC      1           /* seconds between writes of the buffer */
+
+typedef struct trace_tag {
+	FILE                *file;
+	unsigned long long  start;      /* real time capture began, ns */
+	unsigned long long  origin;     /* capture: monotonic time of the start, ns */
+	unsigned long long  last;       /* ns from the start to the last record */
+	char                buffer[TRACE_BUFFER];
+} trace_t;
+
+int trace_create (trace_t *trace, const char *path);
+int trace_write (trace_t *trace, const char *line);
+int trace_sync (trace_t *trace);
+int trace_close (trace_t *trace);
+int trace_open (trace_t *trace, const char *path);
+int trace_read (trace_t *trace, unsigned long long *at, char *line, size_t size);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * type_set.c
+ * Message type sets; see type_set.h.
+ */
+#include "type_set.h"
+#include "errors.h"
+
+#define TYPE_DIGITS_MAX     9
+
+static int range_by_lo (const void *a, const void *b)
+{
+	const type_range_t *x = a, *y = b;
+
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+/*
+ * Read 1 to TYPE_DIGITS_MAX digits at *text into *value and advance
+ * past them. Returns -1 if there are none, or too many.
+ */
+static int parse_type (const char **text, unsigned int *value)
+{
+	const char *p = *text;
+
+	*value = 0;
+	while (*p >= '0' && *p <= '9' && p - *text < TYPE_DIGITS_MAX)
+		*value = *value * 10 + (*p++ - '0');
+	if (p == *text || (*p >= '0' && *p <= '9'))
+		return -1;
+	*text = p;
+	return 0;
+}
+
+/*
+ * Parse the types following "MessageType(": items separated by
+ * commas, each a type or a range "lo-hi", ending with ")". A lone
+ * type is not a set, nor is a list that comes down to one type: *set
+ * is then NULL and the caller goes on using the type get_cmd_type
+ * found. Returns 0, -1 if the list is malformed
+ * or holds a type below 1, or ENOMEM.
+ */
+int type_set_parse (const char *text, type_set_t **set)
+{
+	type_range_t *ranges;
+	const char *p;
+	long items = 1, count, i;
+
+	*set = NULL;
+	for (p = text; *p >= '0' && *p <= '9'; p++)
+		;
+	if (*p != ',' && *p != '-')
+		return 0;
+	for (p = text; *p != '\0' && *p != ')'; p++)
+		items += *p == ',';
+	ranges = malloc (items * sizeof (*ranges));
+	if (ranges == NULL)
+		return ENOMEM;
+	p = text;
+	for (i = 0; i < items; i++) {
+		if (parse_type (&p, &ranges[i].lo) != 0)
+			break;
+		ranges[i].hi = ranges[i].lo;
+		if (*p == '-') {
+			p++;
+			if (parse_type (&p, &ranges[i].hi) != 0)
+				break;
+		}
+		if (ranges[i].lo < 1 || ranges[i].hi < ranges[i].lo)
+			break;
+		if (*p != (i + 1 < items ? ',' : ')'))
+			break;
+		p++;
+	}
+	if (i < items) {
+		free (ranges);
+		return -1;
+	}
+
+	/*
+	 * Sort, then merge ranges that overlap or touch
+	 */
+	qsort (ranges, items, sizeof (*ranges), range_by_lo);
+	for (count = 0, i = 0; i < items; i++) {
+		if (count > 0 && ranges[i].lo <= ranges[count - 1].hi + 1) {
+			if (ranges[i].hi > ranges[count - 1].hi)
+				ranges[count - 1].hi = ranges[i].hi;
+		} else
+			ranges[count++] = ranges[i];
+	}
+	if (count == 1 && ranges[0].lo == ranges[0].hi) {
+		free (ranges);
+		return 0;
+	}
+	*set = malloc (sizeof (**set));
+	if (*set == NULL) {
+		free (ranges);
+		return ENOMEM;
+	}
+	(*set)->count = count;
+	(*set)->ranges = ranges;
+	return 0;
+}
+
+/*
+ * Index of the range holding type, or -1.
+ */
+static long type_set_find (const type_set_t *set, unsigned int type)
+{
+	long lo = 0, hi = set->count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (type < set->ranges[mid].lo)
+			hi = mid - 1;
+		else if (type > set->ranges[mid].hi)
+			lo = mid + 1;
+		else
+			return mid;
+	}
+	return -1;
+}
+
+int type_set_has (const type_set_t *set, unsigned int type)
+{
+	return type_set_find (set, type) >= 0;
+}
+
+/*
+ * Whether the set holds type and nothing else.
+ */
+int type_set_is (const type_set_t *set, unsigned int type)
+{
+	return set->count == 1 && set->ranges[0].lo == type && set->ranges[0].hi == type;
+}
+
+/*
+ * Take type out of the set, splitting its range if it lies inside one.
+ * Returns 0, or ENOMEM if a split range could not be stored.
+ */
+int type_set_remove (type_set_t *set, unsigned int type)
+{
+	type_range_t *ranges, *r;
+	long i = type_set_find (set, type);
+
+	if (i < 0)
+		return 0;
+	r = &set->ranges[i];
+	if (r->lo == r->hi) {
+		memmove (r, r + 1, (set->count - i - 1) * sizeof (*r));
+		set->count--;
+	} else if (type == r->lo) {
+		r->lo++;
+	} else if (type == r->hi) {
+		r->hi--;
+	} else {
+		ranges = realloc (set->ranges, (set->count + 1) * sizeof (*ranges));
+		if (ranges == NULL)
+			return ENOMEM;
+		set->ranges = ranges;
+		r = &ranges[i];
+		memmove (r + 1, r, (set->count - i) * sizeof (*r));
+		r[0].hi = type - 1;
+		r[1].lo = type + 1;
+		set->count++;
+	}
+	return 0;
+}
+
+int type_set_equal (const type_set_t *a, const type_set_t *b)
+{
+	return a->count == b->count
+		&& memcmp (a->ranges, b->ranges, a->count * sizeof (*a->ranges)) == 0;
+}
+
+/*
+ * Write the set as it would be given to Create_Thread, e.g. "2-3,7",
+ * ending with "..." if it does not fit in size characters.
+ */
+void type_set_format (const type_set_t *set, char *buf, size_t size)
+{
+	char item[32];
+	size_t used = 0, len;
+	long i;
+
+	buf[0] = '\0';
+	for (i = 0; i < set->count; i++) {
+		if (set->ranges[i].lo == set->ranges[i].hi)
+			len = snprintf (item, sizeof (item), "%s%u", i ? "," : "", set->ranges[i].lo);
+		else
+			len = snprintf (item, sizeof (item), "%s%u-%u", i ? "," : "",
+				set->ranges[i].lo, set->ranges[i].hi);
+		if (used + len + (i + 1 < set->count ? 3 : 0) >= size) {
+			if (used + 3 < size)
+				strcpy (buf + used, "...");
+			return;
+		}
+		strcpy (buf + used, item);
+		used += len;
+	}
+}
+
+void type_set_free (type_set_t *set)
+{
+	if (set == NULL)
+		return;
+	free (set->ranges);
+	free (set);
+}
@@ -0,0 +1,32 @@
+/*
+ * type_set.h
+ * Sets of message types, for alarm threads created with a list or
+ * range of types, e.g. "Create_Thread: MessageType(2,3,7)" or
+ * "MessageType(10-99)". A set is kept as sorted, disjoint ranges, so
+ * thousands of types cost a few bytes and membership is a binary
+ * search. Sets are only changed under alarm_mutex.
+ */
+#ifndef __type_set_h
+#define __type_set_h
+
+#include <stddef.h>
+
+typedef struct type_range_tag {
+	unsigned int        lo;
+	unsigned int        hi;
+} type_range_t;
+
+typedef struct type_set_tag {
+	long                count;      /* ranges */
+	type_range_t        *ranges;    /* ascending, neither overlapping nor adjacent */
+} type_set_t;
+
+int type_set_parse (const char *text, type_set_t **set);
+int type_set_has (const type_set_t *set, unsigned int type);
+int type_set_remove (type_set_t *set, unsigned int type);
+int type_set_is (const type_set_t *set, unsigned int type);
+int type_set_equal (const type_set_t *a, const type_set_t *b);
+void type_set_format (const type_set_t *set, char *buf, size_t size);
+void type_set_free (type_set_t *set);
+
+#endif